@@ -0,0 +1,221 @@
+// audiodecoder.cpp - Version 1.4
+// Change-log:
+// - Version 1.4: pushPacket chuyển dữ liệu packet (av_packet_move_ref) vào vỏ AVPacket lấy từ danh sách
+//   dùng lại thay vì av_packet_clone mỗi packet; số lần cấp phát đi vào getAllocationStats.
+// - Version 1.3: Cảnh báo hàng đợi packet đầy chỉ in ở packet bị bỏ đầu tiên rồi mỗi kDropLogInterval
+//   packet, thay vì mỗi packet (vài chục lần mỗi giây khi không có gì đọc âm thanh).
+// - Version 1.2:
+//   - writePcm chờ AudioRingBuffer::waitForFreeSpace (sink đọc bớt thì đánh thức) thay vì ngủ 5 ms rồi
+//     thử lại; flush/close đánh thức luồng đang chờ.
+//   - Bỏ isOpen() không dùng.
+// - Version 1.1: Dùng kMicrosecondTimeBase chung (avtime.h).
+#include "audiodecoder.h"
+#include "avtime.h"
+#include <QDebug>
+#include <QMutexLocker>
+#include <QThread>
+
+extern "C" {
+#include <libavutil/opt.h>
+#include <libavutil/channel_layout.h>
+}
+
+namespace {
+// Giới hạn an toàn cho hàng đợi packet (vài giây âm thanh); vượt quá thì bỏ packet cũ nhất
+const size_t kMaxQueuedPackets = 512;
+const quint64 kDropLogInterval = 1000;
+}
+
+AudioDecoder::AudioDecoder(std::shared_ptr<AudioRingBuffer> ring) : m_ring(std::move(ring))
+{
+}
+
+AudioDecoder::~AudioDecoder()
+{
+    close();
+}
+
+bool AudioDecoder::open(const AVCodecParameters *codecParameters, AVRational timeBase)
+{
+    close();
+    const AVCodec *codec = avcodec_find_decoder(codecParameters->codec_id);
+    if (!codec) return false;
+    m_codecContext = avcodec_alloc_context3(codec);
+    if (!m_codecContext || avcodec_parameters_to_context(m_codecContext, codecParameters) < 0
+        || avcodec_open2(m_codecContext, codec, nullptr) < 0) {
+        avcodec_free_context(&m_codecContext);
+        return false;
+    }
+
+    AVChannelLayout outLayout;
+    av_channel_layout_default(&outLayout, kChannels);
+    if (swr_alloc_set_opts2(&m_swrContext, &outLayout, AV_SAMPLE_FMT_S16, kSampleRate,
+                            &m_codecContext->ch_layout, m_codecContext->sample_fmt, m_codecContext->sample_rate,
+                            0, nullptr) < 0 || swr_init(m_swrContext) < 0) {
+        swr_free(&m_swrContext);
+        avcodec_free_context(&m_codecContext);
+        return false;
+    }
+
+    m_frame = av_frame_alloc();
+    m_timeBase = timeBase;
+    m_stopping = false;
+    m_droppedPackets = 0;
+    m_ring->discardAll();
+    m_thread.reset(QThread::create([this]() { decodeLoop(); }));
+    m_thread->setObjectName("AudioDecode");
+    // Âm thanh bị ngắt quãng dễ nhận ra hơn hình: ưu tiên cao hơn luồng giải mã video
+    m_thread->start(QThread::HighPriority);
+    return true;
+}
+
+void AudioDecoder::close()
+{
+    if (m_thread) {
+        {
+            QMutexLocker locker(&m_mutex);
+            m_stopping = true;
+        }
+        m_packetAvailable.wakeAll();
+        m_ring->wakeWriter();
+        m_thread->wait();
+        m_thread.reset();
+    }
+    {
+        QMutexLocker locker(&m_mutex);
+        for (AVPacket *packet : m_packets) av_packet_free(&packet);
+        m_packets.clear();
+        for (AVPacket *packet : m_freePackets) av_packet_free(&packet);
+        m_freePackets.clear();
+    }
+    av_frame_free(&m_frame);
+    swr_free(&m_swrContext);
+    avcodec_free_context(&m_codecContext);
+    av_freep(&m_resampleBuffer);
+    m_resampleBufferSize = 0;
+}
+
+void AudioDecoder::pushPacket(AVPacket *packet)
+{
+    if (!m_thread) return;
+    {
+        QMutexLocker locker(&m_mutex);
+        AVPacket *queued = nullptr;
+        if (!m_freePackets.empty()) {
+            queued = m_freePackets.back();
+            m_freePackets.pop_back();
+        } else {
+            queued = av_packet_alloc();
+            if (!queued) return;
+            m_packetAllocations++;
+        }
+        // Không sao chép hay thêm tham chiếu: bộ đệm của demuxer chuyển thẳng sang hàng đợi
+        av_packet_move_ref(queued, packet);
+        if (m_packets.size() >= kMaxQueuedPackets) {
+            if (m_droppedPackets++ % kDropLogInterval == 0) {
+                qWarning() << "Audio packet queue full, dropped" << m_droppedPackets << "packet(s) so far";
+            }
+            recyclePacketLocked(m_packets.front());
+            m_packets.pop_front();
+        }
+        m_packets.push_back(queued);
+    }
+    m_packetAvailable.wakeOne();
+}
+
+void AudioDecoder::flush()
+{
+    if (!m_thread) return;
+    QMutexLocker locker(&m_mutex);
+    for (AVPacket *packet : m_packets) recyclePacketLocked(packet);
+    m_packets.clear();
+    m_currentGeneration = ++m_generation;
+    m_packetAvailable.wakeOne();
+    // Luồng giải mã có thể đang chờ sink đọc bớt PCM cũ
+    m_ring->wakeWriter();
+}
+
+void AudioDecoder::decodeLoop()
+{
+    while (true) {
+        AVPacket *packet = nullptr;
+        quint64 generation = 0;
+        {
+            QMutexLocker locker(&m_mutex);
+            while (!m_stopping && m_packets.empty() && m_handledGeneration == m_generation) {
+                m_packetAvailable.wait(&m_mutex);
+            }
+            if (m_stopping) return;
+            generation = m_generation;
+            if (m_handledGeneration == generation) {
+                packet = m_packets.front();
+                m_packets.pop_front();
+            }
+        }
+
+        if (m_handledGeneration != generation) {
+            // Xử lý flush trước mọi packet đến sau nó
+            avcodec_flush_buffers(m_codecContext);
+            swr_init(m_swrContext);
+            m_ring->discardAll();
+            m_handledGeneration = generation;
+            continue;
+        }
+        decodePacket(packet, generation);
+        QMutexLocker locker(&m_mutex);
+        recyclePacketLocked(packet);
+    }
+}
+
+void AudioDecoder::recyclePacketLocked(AVPacket *packet)
+{
+    av_packet_unref(packet);
+    m_freePackets.push_back(packet);
+}
+
+quint64 AudioDecoder::packetAllocations() const
+{
+    return m_packetAllocations;
+}
+
+void AudioDecoder::decodePacket(AVPacket *packet, quint64 generation)
+{
+    if (avcodec_send_packet(m_codecContext, packet) < 0) return;
+    while (avcodec_receive_frame(m_codecContext, m_frame) == 0) {
+        const int maxSamples = av_rescale_rnd(swr_get_delay(m_swrContext, m_frame->sample_rate) + m_frame->nb_samples,
+                                              kSampleRate, m_frame->sample_rate, AV_ROUND_UP);
+        av_fast_malloc(&m_resampleBuffer, &m_resampleBufferSize, maxSamples * kChannels * sizeof(int16_t));
+        int samples = 0;
+        if (m_resampleBuffer) {
+            uint8_t *output[] = { m_resampleBuffer };
+            samples = swr_convert(m_swrContext, output, maxSamples,
+                                  (const uint8_t **)m_frame->extended_data, m_frame->nb_samples);
+        }
+        const int64_t pts = m_frame->pts != AV_NOPTS_VALUE ? m_frame->pts : m_frame->best_effort_timestamp;
+        const int64_t endUs = pts == AV_NOPTS_VALUE ? AV_NOPTS_VALUE
+            : av_rescale_q(pts, m_timeBase, kMicrosecondTimeBase) + int64_t(m_frame->nb_samples) * 1000000 / m_frame->sample_rate;
+        av_frame_unref(m_frame);
+
+        if (samples <= 0) continue;
+        if (!writePcm(reinterpret_cast<const char*>(m_resampleBuffer), samples * kChannels * sizeof(int16_t), generation)) return;
+        if (endUs != AV_NOPTS_VALUE) m_ring->markWriteTime(endUs);
+    }
+}
+
+bool AudioDecoder::writePcm(const char *data, qsizetype size, quint64 generation)
+{
+    while (size > 0) {
+        // Đã tua hoặc đang đóng: phần còn lại là âm thanh cũ
+        if (m_currentGeneration != generation) return false;
+        {
+            QMutexLocker locker(&m_mutex);
+            if (m_stopping) return false;
+        }
+        const qsizetype written = m_ring->write(data, size);
+        data += written;
+        size -= written;
+        // Bộ đệm đầy (sink đang tạm dừng hoặc đã đủ dữ liệu trước): chờ sink đọc bớt
+        if (size > 0) m_ring->waitForFreeSpace();
+    }
+    return true;
+}
@@ -0,0 +1,76 @@
+// audiodecoder.h - Version 1.3 (Dùng lại AVPacket của hàng đợi)
+// Giải mã âm thanh trên luồng riêng: VideoProcessor (luồng đọc packet) chuyển packet âm thanh vào
+// hàng đợi, luồng này giải mã + resample sang S16 stereo 44.1 kHz và ghi vào AudioRingBuffer.
+// Nhờ vậy âm thanh không còn đi kèm frame video qua luồng giao diện.
+#ifndef AUDIODECODER_H
+#define AUDIODECODER_H
+
+#include <QMutex>
+#include <QWaitCondition>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <vector>
+#include "audioringbuffer.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libswresample/swresample.h>
+}
+
+class QThread;
+
+class AudioDecoder
+{
+public:
+    static constexpr int kSampleRate = 44100;
+    static constexpr int kChannels = 2;
+    static constexpr int kBytesPerSecond = kSampleRate * kChannels * int(sizeof(int16_t));
+
+    explicit AudioDecoder(std::shared_ptr<AudioRingBuffer> ring);
+    ~AudioDecoder();
+
+    // Mở decoder cho luồng âm thanh (timeBase của luồng) và khởi động luồng giải mã
+    bool open(const AVCodecParameters *codecParameters, AVRational timeBase);
+    void close();
+
+    // Gọi từ luồng đọc packet; không chặn. Lấy luôn dữ liệu của packet (av_packet_move_ref),
+    // packet trả về ở trạng thái rỗng.
+    void pushPacket(AVPacket *packet);
+    // Bỏ packet đang chờ, trạng thái decoder và PCM chưa phát (sau khi tua)
+    void flush();
+    // Số AVPacket đã cấp phát cho hàng đợi (khi phát ổn định phải giữ nguyên)
+    quint64 packetAllocations() const;
+
+private:
+    void decodeLoop();
+    void decodePacket(AVPacket *packet, quint64 generation);
+    bool writePcm(const char *data, qsizetype size, quint64 generation);
+    // Bỏ dữ liệu của packet và đưa vỏ AVPacket về m_freePackets (đang giữ m_mutex)
+    void recyclePacketLocked(AVPacket *packet);
+
+    std::shared_ptr<AudioRingBuffer> m_ring;
+    std::unique_ptr<QThread> m_thread;
+
+    // Hàng đợi packet (bảo vệ bởi m_mutex)
+    QMutex m_mutex;
+    QWaitCondition m_packetAvailable;
+    std::deque<AVPacket*> m_packets;
+    std::vector<AVPacket*> m_freePackets; // Vỏ AVPacket rỗng để dùng lại, tối đa kMaxQueuedPackets + 1
+    std::atomic<quint64> m_packetAllocations = 0;
+    quint64 m_generation = 0; // Tăng mỗi lần flush()
+    quint64 m_droppedPackets = 0; // Packet bị bỏ vì hàng đợi đầy, kể từ lần open() gần nhất
+    bool m_stopping = false;
+    std::atomic<quint64> m_currentGeneration = 0;
+
+    // Chỉ luồng giải mã truy cập
+    AVCodecContext *m_codecContext = nullptr;
+    SwrContext *m_swrContext = nullptr;
+    AVFrame *m_frame = nullptr;
+    AVRational m_timeBase = {0, 1};
+    uint8_t *m_resampleBuffer = nullptr;
+    unsigned int m_resampleBufferSize = 0;
+    quint64 m_handledGeneration = 0;
+};
+
+#endif // AUDIODECODER_H
@@ -0,0 +1,141 @@
+// audiooutput.cpp - Version 1.2
+// Change-log:
+// - Version 1.2: Phát outputAvailableChanged: không có thiết bị mặc định, sink lỗi khi mở hoặc mất thiết
+//   bị khi đang phát thì báo false để VideoWorker bỏ packet âm thanh như khi tắt tiếng.
+// - Version 1.1: So với AudioRingBuffer::kNoTime thay cho INT64_MIN.
+#include "audiooutput.h"
+#include "audioringbuffer.h"
+#include "playbackclock.h"
+#include <QAudioSink>
+#include <QDebug>
+#include <QIODevice>
+#include <QMediaDevices>
+#include <QTimer>
+#include <cstring>
+
+namespace {
+// Bộ đệm của sink nhỏ: dữ liệu chờ phát đã nằm trong AudioRingBuffer
+const int kSinkBufferMs = 150;
+const int kClockUpdateMs = 10;
+
+// Thiết bị chỉ đọc, được sink gọi trên luồng âm thanh; không khóa, không cấp phát
+class AudioPullDevice : public QIODevice
+{
+public:
+    AudioPullDevice(std::shared_ptr<AudioRingBuffer> ring, QObject *parent)
+        : QIODevice(parent), m_ring(std::move(ring)) {}
+
+    bool isSequential() const override { return true; }
+    qint64 bytesAvailable() const override { return m_ring->available() + QIODevice::bytesAvailable(); }
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override
+    {
+        const qint64 count = m_ring->read(data, maxSize);
+        // Thiếu dữ liệu: trả về khoảng lặng để sink không chuyển sang Idle rồi phải khởi động lại
+        if (count < maxSize) std::memset(data + count, 0, size_t(maxSize - count));
+        return maxSize;
+    }
+    qint64 writeData(const char *, qint64) override { return -1; }
+
+private:
+    std::shared_ptr<AudioRingBuffer> m_ring;
+};
+}
+
+AudioOutput::AudioOutput(std::shared_ptr<AudioRingBuffer> ring, std::shared_ptr<PlaybackClock> clock, QObject *parent)
+    : QObject(parent), m_ring(std::move(ring)), m_clock(std::move(clock))
+{
+}
+
+AudioOutput::~AudioOutput()
+{
+    stop();
+}
+
+void AudioOutput::start(int sampleRate, int channels)
+{
+    stop();
+    QAudioFormat format;
+    format.setSampleRate(sampleRate);
+    format.setChannelCount(channels);
+    format.setSampleFormat(QAudioFormat::Int16);
+
+    const QAudioDevice device = QMediaDevices::defaultAudioOutput();
+    if (device.isNull()) {
+        qWarning() << "No default audio output device";
+        emit outputAvailableChanged(false);
+        return;
+    }
+
+    m_sink = new QAudioSink(device, format, this);
+    m_sink->setBufferSize(format.bytesForDuration(kSinkBufferMs * 1000));
+    m_sink->setVolume(m_volume);
+    m_device = new AudioPullDevice(m_ring, this);
+    m_device->open(QIODevice::ReadOnly);
+    m_sink->start(m_device);
+    if (m_sink->error() != QAudio::NoError) {
+        qWarning() << "Audio output failed to start:" << m_sink->error();
+        stop();
+        return;
+    }
+    // Mất thiết bị khi đang phát (rút tai nghe USB...): sink dừng với lỗi
+    connect(m_sink, &QAudioSink::stateChanged, this, [this](QAudio::State state) {
+        if (state == QAudio::StoppedState && m_sink && m_sink->error() != QAudio::NoError) {
+            qWarning() << "Audio output stopped:" << m_sink->error();
+            stop();
+        }
+    });
+    if (!m_active) m_sink->suspend();
+
+    if (!m_clockTimer) {
+        m_clockTimer = new QTimer(this);
+        m_clockTimer->setTimerType(Qt::PreciseTimer);
+        connect(m_clockTimer, &QTimer::timeout, this, &AudioOutput::updateClock);
+    }
+    m_clockTimer->start(kClockUpdateMs);
+    emit outputAvailableChanged(true);
+}
+
+void AudioOutput::stop()
+{
+    if (m_clockTimer) m_clockTimer->stop();
+    if (m_sink) {
+        // deleteLater: stop() có thể được gọi từ slot stateChanged của chính sink
+        m_sink->disconnect(this);
+        m_sink->stop();
+        m_sink->deleteLater();
+        m_sink = nullptr;
+    }
+    if (m_device) m_device->deleteLater();
+    m_device = nullptr;
+    emit outputAvailableChanged(false);
+}
+
+void AudioOutput::setActive(bool active)
+{
+    m_active = active;
+    if (!m_sink) return;
+    if (active) {
+        m_sink->resume();
+    } else {
+        m_sink->suspend();
+    }
+}
+
+void AudioOutput::setVolume(float volume)
+{
+    m_volume = volume;
+    if (m_sink) m_sink->setVolume(volume);
+}
+
+void AudioOutput::updateClock()
+{
+    // Chỉ neo đồng hồ khi đang thật sự phát âm thanh (hết âm thanh thì đồng hồ monotonic tự chạy)
+    if (!m_sink || !m_active || m_ring->available() <= 0) return;
+    const qint64 readTimeUs = m_ring->timeAtReadPosition();
+    if (readTimeUs == AudioRingBuffer::kNoTime) return;
+    // Phần đã kéo khỏi ring nhưng còn nằm trong bộ đệm của sink thì chưa phát ra loa
+    const qsizetype queuedBytes = qMax<qsizetype>(0, m_sink->bufferSize() - m_sink->bytesFree());
+    m_clock->setAudioTime(readTimeUs - m_sink->format().durationForBytes(queuedBytes));
+}
@@ -0,0 +1,50 @@
+// audiooutput.h - Version 1.1 (Báo khi không phát được âm thanh)
+// Phát âm thanh ở chế độ pull: QAudioSink (trên luồng âm thanh riêng) tự kéo PCM từ AudioRingBuffer
+// qua một QIODevice, nên luồng giao diện bận (vd. ghép ảnh trong ViewPanel) không làm âm thanh bị ngắt.
+// Đồng thời cập nhật PlaybackClock theo vị trí âm thanh đang thực sự phát.
+#ifndef AUDIOOUTPUT_H
+#define AUDIOOUTPUT_H
+
+#include <QObject>
+#include <memory>
+
+class QAudioSink;
+class QIODevice;
+class QTimer;
+class AudioRingBuffer;
+class PlaybackClock;
+
+class AudioOutput : public QObject
+{
+    Q_OBJECT
+
+public:
+    AudioOutput(std::shared_ptr<AudioRingBuffer> ring, std::shared_ptr<PlaybackClock> clock, QObject *parent = nullptr);
+    ~AudioOutput();
+
+public slots:
+    // Mở thiết bị mặc định với định dạng S16; bắt đầu ở trạng thái tạm dừng
+    void start(int sampleRate, int channels);
+    void stop();
+    void setActive(bool active);
+    void setVolume(float volume);
+
+signals:
+    // false khi không có thiết bị/sink lỗi/đã dừng: không ai đọc AudioRingBuffer nên VideoWorker phải
+    // ngừng đưa âm thanh vào (nối tới VideoWorker::setAudioOutputAvailable)
+    void outputAvailableChanged(bool available);
+
+private slots:
+    void updateClock();
+
+private:
+    std::shared_ptr<AudioRingBuffer> m_ring;
+    std::shared_ptr<PlaybackClock> m_clock;
+    QAudioSink *m_sink = nullptr;
+    QIODevice *m_device = nullptr;
+    QTimer *m_clockTimer = nullptr;
+    float m_volume = 1.0f;
+    bool m_active = false;
+};
+
+#endif // AUDIOOUTPUT_H
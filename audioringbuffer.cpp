@@ -0,0 +1,113 @@
+// audioringbuffer.cpp - Version 1.2
+// Change-log:
+// - Version 1.2: read() đánh thức producer cả khi chỉ nhảy qua phần đã bỏ (discardAll) mà không đọc được
+//   byte nào; trước đây bộ đệm đầy lúc tua làm luồng giải mã âm thanh chờ mãi.
+// - Version 1.1: Thêm waitForFreeSpace/wakeWriter để luồng giải mã âm thanh chờ sink đọc thay vì ngủ 5 ms
+//   rồi thử lại; dùng kNoTime thay cho INT64_MIN viết tại chỗ.
+#include "audioringbuffer.h"
+#include <QMutexLocker>
+#include <cstring>
+
+AudioRingBuffer::AudioRingBuffer(qsizetype capacityBytes, int bytesPerSecond)
+    : m_bytesPerSecond(qMax(1, bytesPerSecond))
+{
+    quint64 capacity = 1;
+    while (capacity < quint64(qMax<qsizetype>(1, capacityBytes))) capacity <<= 1;
+    m_data.resize(capacity);
+    m_mask = capacity - 1;
+}
+
+qsizetype AudioRingBuffer::write(const char *data, qsizetype size)
+{
+    const quint64 writePos = m_writePos.load(std::memory_order_relaxed);
+    const quint64 readPos = m_readPos.load(std::memory_order_acquire);
+    const qsizetype count = qMin<qsizetype>(size, qsizetype(m_data.size() - (writePos - readPos)));
+    if (count <= 0) return 0;
+
+    const qsizetype offset = qsizetype(writePos & m_mask);
+    const qsizetype first = qMin<qsizetype>(count, qsizetype(m_data.size()) - offset);
+    std::memcpy(m_data.data() + offset, data, first);
+    std::memcpy(m_data.data(), data + first, count - first);
+    m_writePos.store(writePos + count, std::memory_order_release);
+    return count;
+}
+
+qsizetype AudioRingBuffer::freeSpace() const
+{
+    return qsizetype(m_data.size() - (m_writePos.load(std::memory_order_relaxed) - m_readPos.load(std::memory_order_acquire)));
+}
+
+void AudioRingBuffer::discardAll()
+{
+    m_discardPos.store(m_writePos.load(std::memory_order_relaxed), std::memory_order_release);
+    QMutexLocker locker(&m_timeMutex);
+    m_timeAnchorUs = kNoTime;
+}
+
+void AudioRingBuffer::markWriteTime(qint64 endUs)
+{
+    QMutexLocker locker(&m_timeMutex);
+    m_timeAnchorPos = m_writePos.load(std::memory_order_relaxed);
+    m_timeAnchorUs = endUs;
+}
+
+void AudioRingBuffer::waitForFreeSpace()
+{
+    QMutexLocker locker(&m_spaceMutex);
+    m_writerWaiting.store(true);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    // Kiểm tra lại sau khi bật cờ: read() chạy trước đó đã giải phóng chỗ thì không chờ
+    while (freeSpace() == 0 && !m_wakeRequested) m_spaceAvailable.wait(&m_spaceMutex);
+    m_wakeRequested = false;
+    m_writerWaiting.store(false);
+}
+
+void AudioRingBuffer::wakeWriter()
+{
+    QMutexLocker locker(&m_spaceMutex);
+    m_wakeRequested = true;
+    m_spaceAvailable.wakeAll();
+}
+
+qsizetype AudioRingBuffer::read(char *data, qsizetype size)
+{
+    const quint64 previousReadPos = m_readPos.load(std::memory_order_relaxed);
+    quint64 readPos = previousReadPos;
+    const quint64 writePos = m_writePos.load(std::memory_order_acquire);
+    // Dữ liệu trước mốc discardAll() không còn giá trị (vd. âm thanh trước khi tua)
+    const quint64 discardPos = m_discardPos.load(std::memory_order_acquire);
+    if (readPos < discardPos) readPos = discardPos;
+
+    const qsizetype count = qMin<qsizetype>(size, qsizetype(writePos - readPos));
+    if (count > 0) {
+        const qsizetype offset = qsizetype(readPos & m_mask);
+        const qsizetype first = qMin<qsizetype>(count, qsizetype(m_data.size()) - offset);
+        std::memcpy(data, m_data.data() + offset, first);
+        std::memcpy(data + first, m_data.data(), count - first);
+    }
+    const quint64 newReadPos = readPos + qMax<qsizetype>(0, count);
+    m_readPos.store(newReadPos, std::memory_order_seq_cst);
+    // Cùng seq_cst với waitForFreeSpace: hoặc producer thấy chỗ trống, hoặc ở đây thấy cờ chờ.
+    // Vị trí đọc có thể tiến mà count == 0 (nhảy qua dữ liệu đã bỏ): vẫn phải đánh thức.
+    if (newReadPos != previousReadPos && m_writerWaiting.load()) {
+        QMutexLocker locker(&m_spaceMutex);
+        m_spaceAvailable.wakeAll();
+    }
+    return qMax<qsizetype>(0, count);
+}
+
+qsizetype AudioRingBuffer::available() const
+{
+    const quint64 writePos = m_writePos.load(std::memory_order_acquire);
+    const quint64 readPos = qMax(m_readPos.load(std::memory_order_acquire), m_discardPos.load(std::memory_order_acquire));
+    return qsizetype(writePos - readPos);
+}
+
+qint64 AudioRingBuffer::timeAtReadPosition() const
+{
+    const quint64 readPos = qMax(m_readPos.load(std::memory_order_acquire), m_discardPos.load(std::memory_order_acquire));
+    QMutexLocker locker(&m_timeMutex);
+    if (m_timeAnchorUs == kNoTime) return kNoTime;
+    const qint64 pendingBytes = qint64(m_timeAnchorPos) - qint64(readPos);
+    return m_timeAnchorUs - pendingBytes * 1000000 / m_bytesPerSecond;
+}
@@ -0,0 +1,63 @@
+// audioringbuffer.h - Version 1.2 (Đánh thức producer khi vị trí đọc nhảy qua phần đã bỏ)
+// Bộ đệm vòng PCM một producer / một consumer, không khóa: luồng giải mã âm thanh ghi,
+// thiết bị của QAudioSink (luồng âm thanh) đọc. Vị trí đọc/ghi là bộ đếm byte tăng dần.
+// Consumer chỉ lấy khóa khi producer đang chờ chỗ trống.
+#ifndef AUDIORINGBUFFER_H
+#define AUDIORINGBUFFER_H
+
+#include <QMutex>
+#include <QWaitCondition>
+#include <QtGlobal>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+class AudioRingBuffer
+{
+public:
+    // Giá trị của timeAtReadPosition khi chưa có mốc thời gian
+    static constexpr qint64 kNoTime = INT64_MIN;
+
+    // capacityBytes được làm tròn lên lũy thừa của 2; bytesPerSecond dùng để đổi byte sang thời gian
+    AudioRingBuffer(qsizetype capacityBytes, int bytesPerSecond);
+
+    // --- Phía producer ---
+    // Ghi tối đa size byte, trả về số byte đã ghi (ít hơn khi bộ đệm đầy)
+    qsizetype write(const char *data, qsizetype size);
+    qsizetype freeSpace() const;
+    // Bỏ mọi dữ liệu chưa đọc (consumer sẽ nhảy qua ở lần đọc kế tiếp). Chỗ trống chỉ được trả lại
+    // cho producer khi consumer đã nhảy qua, để không ghi đè phần consumer có thể đang đọc.
+    void discardAll();
+    // Mốc thời gian (micro giây) ngay sau byte cuối cùng vừa ghi
+    void markWriteTime(qint64 endUs);
+    // Chặn khi bộ đệm đầy, tới khi consumer đọc bớt hoặc wakeWriter() được gọi
+    void waitForFreeSpace();
+    // Đánh thức producer đang chờ trong waitForFreeSpace (gọi từ luồng bất kỳ, vd. khi tua/đóng)
+    void wakeWriter();
+
+    // --- Phía consumer ---
+    qsizetype read(char *data, qsizetype size);
+
+    qsizetype available() const;
+    // Thời điểm của byte ở vị trí đọc; kNoTime nếu chưa có mốc
+    qint64 timeAtReadPosition() const;
+
+private:
+    std::vector<char> m_data;
+    quint64 m_mask;
+    int m_bytesPerSecond;
+    std::atomic<quint64> m_writePos = 0;
+    std::atomic<quint64> m_readPos = 0;
+    std::atomic<quint64> m_discardPos = 0;
+    // Mốc thời gian chỉ được đọc bởi timer cập nhật đồng hồ, không nằm trên đường đọc của sink
+    mutable QMutex m_timeMutex;
+    quint64 m_timeAnchorPos = 0;
+    qint64 m_timeAnchorUs = kNoTime;
+    // Producer chờ chỗ trống; read() chỉ lấy m_spaceMutex khi m_writerWaiting bật
+    QMutex m_spaceMutex;
+    QWaitCondition m_spaceAvailable;
+    std::atomic<bool> m_writerWaiting = false;
+    bool m_wakeRequested = false;
+};
+
+#endif // AUDIORINGBUFFER_H
@@ -0,0 +1,14 @@
+// avtime.h - Version 1.0
+// Hằng thời gian FFmpeg dùng chung. AV_TIME_BASE_Q là compound literal của C,
+// không dùng được trong C++ trên mọi trình biên dịch (MSVC).
+#ifndef AVTIME_H
+#define AVTIME_H
+
+extern "C" {
+#include <libavutil/avutil.h>
+}
+
+// Time base micro giây (mốc thời gian của giao diện, thanh thời gian, đồng hồ phát)
+inline constexpr AVRational kMicrosecondTimeBase = {1, AV_TIME_BASE};
+
+#endif // AVTIME_H
@@ -0,0 +1,140 @@
+// encodepipeline.cpp - Version 1.2
+// Change-log:
+// - Version 1.2: Bỏ log mỗi ảnh đã ghi và pendingCount (không dùng; số ảnh chờ đã có qua queueChanged).
+// - Version 1.1: Ảnh ImageStore ghi nền không còn hiện trong số ảnh đang ghi (queueChanged).
+#include "encodepipeline.h"
+#include <QDebug>
+#include <QImageWriter>
+#include <QMutexLocker>
+#include <QThread>
+
+EncodePipeline::EncodePipeline(QObject *parent) : QObject(parent)
+{
+    // Mặc định dùng nửa số lõi: phần còn lại dành cho giải mã và giao diện
+    m_pool.setMaxThreadCount(qBound(1, QThread::idealThreadCount() / 2, 4));
+}
+
+EncodePipeline::~EncodePipeline()
+{
+    waitForDone();
+}
+
+void EncodePipeline::setWorkerCount(int count)
+{
+    if (count <= 0) count = qBound(1, QThread::idealThreadCount() / 2, 4);
+    m_pool.setMaxThreadCount(count);
+}
+
+void EncodePipeline::setFormat(Format format)
+{
+    QMutexLocker locker(&m_mutex);
+    m_format = format;
+}
+
+void EncodePipeline::setPngCompression(int level)
+{
+    QMutexLocker locker(&m_mutex);
+    m_pngCompression = qBound(0, level, 9);
+}
+
+void EncodePipeline::setLimits(int maxJobs, qint64 maxBytes)
+{
+    QMutexLocker locker(&m_mutex);
+    m_maxJobs = qMax(1, maxJobs);
+    m_maxBytes = qMax<qint64>(1, maxBytes);
+    m_notFull.wakeAll();
+}
+
+qint64 EncodePipeline::imageBytes(const QImage &image)
+{
+    return image.sizeInBytes();
+}
+
+bool EncodePipeline::hasRoom(qint64 bytes) const
+{
+    // Luôn nhận ít nhất một ảnh để ảnh lớn hơn giới hạn dung lượng không bị chặn mãi
+    if (m_pending == 0) return true;
+    return m_pending < m_maxJobs && m_pendingBytes + bytes <= m_maxBytes;
+}
+
+bool EncodePipeline::trySubmit(const QImage &image, const QString &basePath, Callback done, bool background)
+{
+    if (image.isNull()) return false;
+    QMutexLocker locker(&m_mutex);
+    if (!hasRoom(imageBytes(image))) return false;
+    const int pending = enqueueLocked(image, basePath, std::move(done), background);
+    const int maxJobs = m_maxJobs;
+    locker.unlock();
+    if (!background) emit queueChanged(pending, maxJobs);
+    return true;
+}
+
+bool EncodePipeline::submit(const QImage &image, const QString &basePath, Callback done, const std::atomic<bool> *cancel)
+{
+    if (image.isNull()) return false;
+    const qint64 bytes = imageBytes(image);
+    QMutexLocker locker(&m_mutex);
+    while (!hasRoom(bytes)) {
+        if (cancel && *cancel) return false;
+        // Chờ có hạn để còn kiểm tra cờ hủy
+        m_notFull.wait(&m_mutex, 50);
+    }
+    if (cancel && *cancel) return false;
+    const int pending = enqueueLocked(image, basePath, std::move(done), false);
+    const int maxJobs = m_maxJobs;
+    locker.unlock();
+    emit queueChanged(pending, maxJobs);
+    return true;
+}
+
+int EncodePipeline::enqueueLocked(const QImage &image, const QString &basePath, Callback done, bool background)
+{
+    const qint64 bytes = imageBytes(image);
+    m_pending++;
+    if (!background) m_visiblePending++;
+    m_pendingBytes += bytes;
+
+    const Format format = m_format;
+    // Qt PNG: quality q ứng với mức nén (100 - q) * 9 / 91
+    const int pngQuality = 100 - (m_pngCompression * 91 + 8) / 9;
+    const QString filePath = basePath + (format == FormatBmp ? ".bmp" : ".png");
+
+    m_pool.start([this, image, filePath, format, pngQuality, bytes, done, background]() {
+        QImageWriter writer(filePath, format == FormatBmp ? "BMP" : "PNG");
+        if (format == FormatPng) writer.setQuality(pngQuality);
+        // BMP chỉ có 8 bit mỗi kênh: ảnh chụp 16 bit được hạ xuống trước khi ghi
+        const bool ok = format == FormatBmp && image.depth() > 32
+                            ? writer.write(image.convertToFormat(QImage::Format_RGB32))
+                            : writer.write(image);
+        if (!ok) qWarning() << "Encode failed:" << filePath << writer.errorString();
+        if (done) done(ok, filePath);
+        finishJob(bytes, background);
+    });
+    return m_visiblePending;
+}
+
+void EncodePipeline::finishJob(qint64 bytes, bool background)
+{
+    int pending, maxJobs;
+    {
+        QMutexLocker locker(&m_mutex);
+        m_pending--;
+        if (!background) m_visiblePending--;
+        m_pendingBytes -= bytes;
+        pending = m_visiblePending;
+        maxJobs = m_maxJobs;
+        m_notFull.wakeAll();
+    }
+    if (!background) emit queueChanged(pending, maxJobs);
+}
+
+void EncodePipeline::waitForDone()
+{
+    m_pool.waitForDone();
+}
+
+int EncodePipeline::maxJobs() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_maxJobs;
+}
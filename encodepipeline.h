@@ -0,0 +1,71 @@
+// encodepipeline.h - Version 1.2
+// Hàng đợi mã hóa ảnh chụp có giới hạn, chạy trên QThreadPool riêng (không chiếm pool chung).
+// Số ảnh chờ ghi bị giới hạn theo số lượng và dung lượng: luồng GUI dùng trySubmit (không chặn,
+// báo đầy), luồng nền như chụp loạt dùng submit (chờ đến khi có chỗ).
+#ifndef ENCODEPIPELINE_H
+#define ENCODEPIPELINE_H
+
+#include <QObject>
+#include <QImage>
+#include <QMutex>
+#include <QThreadPool>
+#include <QWaitCondition>
+#include <atomic>
+#include <functional>
+
+class EncodePipeline : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Format {
+        FormatPng, // Không mất dữ liệu, mức nén chỉnh được
+        FormatBmp  // Không nén: ghi nhanh nhất nhưng file lớn
+    };
+
+    // Gọi trên luồng mã hóa sau khi ghi xong; ok = false nếu ghi thất bại
+    using Callback = std::function<void(bool ok, const QString &filePath)>;
+
+    explicit EncodePipeline(QObject *parent = nullptr);
+    ~EncodePipeline(); // Chờ các ảnh đang ghi
+
+    void setWorkerCount(int count);
+    void setFormat(Format format);
+    // 0 (nhanh nhất) .. 9 (file nhỏ nhất); chỉ dùng cho PNG
+    void setPngCompression(int level);
+    void setLimits(int maxJobs, qint64 maxBytes);
+
+    // Ghi ra basePath + đuôi theo định dạng hiện tại. Không chặn: trả về false nếu hàng đợi đầy.
+    // background = ghi nội bộ (ImageStore đẩy ảnh ra đĩa): chiếm chỗ trong hàng đợi nhưng không tính
+    // vào số ảnh báo qua queueChanged.
+    bool trySubmit(const QImage &image, const QString &basePath, Callback done, bool background = false);
+    // Chặn đến khi có chỗ; trả về false nếu cancel được bật trong lúc chờ
+    bool submit(const QImage &image, const QString &basePath, Callback done, const std::atomic<bool> *cancel = nullptr);
+    void waitForDone();
+
+    int maxJobs() const;
+
+signals:
+    // Phát mỗi khi số ảnh chờ ghi mà người dùng yêu cầu thay đổi (từ luồng bất kỳ)
+    void queueChanged(int pending, int maxJobs);
+
+private:
+    static qint64 imageBytes(const QImage &image);
+    bool hasRoom(qint64 bytes) const;
+    // Gọi khi đang giữ m_mutex và đã có chỗ; trả về số ảnh (không tính ghi nền) đang chờ sau khi thêm
+    int enqueueLocked(const QImage &image, const QString &basePath, Callback done, bool background);
+    void finishJob(qint64 bytes, bool background);
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_notFull;
+    QThreadPool m_pool;
+    Format m_format = FormatPng;
+    int m_pngCompression = 1;
+    int m_maxJobs = 16;
+    qint64 m_maxBytes = 512ll * 1024 * 1024;
+    int m_pending = 0;
+    int m_visiblePending = 0; // m_pending trừ các lần ghi nền
+    qint64 m_pendingBytes = 0;
+};
+
+#endif // ENCODEPIPELINE_H
@@ -0,0 +1,110 @@
+// framecache.cpp - Version 1.1
+// Change-log:
+// - Version 1.1: FrameData không còn mang âm thanh.
+#include "framecache.h"
+#include <QMutexLocker>
+
+FrameCache::FrameCache(qint64 maxBytes) : m_maxBytes(qMax<qint64>(1, maxBytes))
+{
+}
+
+void FrameCache::setMaxBytes(qint64 maxBytes)
+{
+    QMutexLocker locker(&m_mutex);
+    m_maxBytes = qMax<qint64>(1, maxBytes);
+    evict();
+}
+
+void FrameCache::insert(const FrameData &frame, int64_t prevPts)
+{
+    if (frame.image.isNull() || frame.pts == AV_NOPTS_VALUE) return;
+    QMutexLocker locker(&m_mutex);
+
+    auto it = m_entries.find(frame.pts);
+    if (it == m_entries.end()) {
+        m_lru.push_front(frame.pts);
+        it = m_entries.emplace(frame.pts, Entry()).first;
+        it->second.lruPos = m_lru.begin();
+    } else {
+        m_lru.splice(m_lru.begin(), m_lru, it->second.lruPos);
+    }
+
+    Entry &entry = it->second;
+    const QSize oldSize = entry.frame.image.size();
+    if (entry.frame.image.isNull()
+        || qint64(frame.image.width()) * frame.image.height() >= qint64(oldSize.width()) * oldSize.height()) {
+        m_bytes -= entry.bytes;
+        entry.frame = frame;
+        entry.bytes = frame.image.sizeInBytes();
+        m_bytes += entry.bytes;
+    }
+
+    if (prevPts != AV_NOPTS_VALUE && prevPts < frame.pts) {
+        entry.prevPts = prevPts;
+        auto prev = m_entries.find(prevPts);
+        if (prev != m_entries.end()) prev->second.nextPts = frame.pts;
+    }
+    evict();
+}
+
+bool FrameCache::find(int64_t pts, FrameData &frame)
+{
+    QMutexLocker locker(&m_mutex);
+    return lookup(pts, frame);
+}
+
+bool FrameCache::findPrevious(int64_t pts, FrameData &frame)
+{
+    QMutexLocker locker(&m_mutex);
+    auto it = m_entries.find(pts);
+    if (it == m_entries.end() || it->second.prevPts == AV_NOPTS_VALUE) return false;
+    return lookup(it->second.prevPts, frame);
+}
+
+bool FrameCache::findNext(int64_t pts, FrameData &frame)
+{
+    QMutexLocker locker(&m_mutex);
+    auto it = m_entries.find(pts);
+    if (it == m_entries.end() || it->second.nextPts == AV_NOPTS_VALUE) return false;
+    return lookup(it->second.nextPts, frame);
+}
+
+void FrameCache::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_entries.clear();
+    m_lru.clear();
+    m_bytes = 0;
+}
+
+int FrameCache::count() const
+{
+    QMutexLocker locker(&m_mutex);
+    return static_cast<int>(m_entries.size());
+}
+
+qint64 FrameCache::bytes() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_bytes;
+}
+
+bool FrameCache::lookup(int64_t pts, FrameData &frame)
+{
+    auto it = m_entries.find(pts);
+    if (it == m_entries.end()) return false;
+    m_lru.splice(m_lru.begin(), m_lru, it->second.lruPos);
+    frame = it->second.frame;
+    return true;
+}
+
+void FrameCache::evict()
+{
+    // Luôn giữ lại frame vừa dùng gần nhất, kể cả khi một frame lớn hơn giới hạn
+    while (m_bytes > m_maxBytes && m_lru.size() > 1) {
+        auto it = m_entries.find(m_lru.back());
+        m_bytes -= it->second.bytes;
+        m_entries.erase(it);
+        m_lru.pop_back();
+    }
+}
@@ -0,0 +1,50 @@
+// framecache.h - Version 1.0
+// Bộ nhớ đệm LRU các frame đã giải mã, khóa theo pts, giới hạn theo dung lượng.
+// Mỗi frame nhớ pts của frame liền trước/liền sau trong cùng một lượt giải mã tuần tự,
+// nên lùi/tiến từng frame trên vùng đã giải mã chỉ cần một lần tra bảng băm.
+#ifndef FRAMECACHE_H
+#define FRAMECACHE_H
+
+#include <QMutex>
+#include <list>
+#include <unordered_map>
+#include "videoprocessor.h"
+
+class FrameCache
+{
+public:
+    explicit FrameCache(qint64 maxBytes = 256ll * 1024 * 1024);
+
+    void setMaxBytes(qint64 maxBytes);
+
+    // prevPts: pts của frame được giải mã ngay trước frame này (AV_NOPTS_VALUE nếu vừa tua).
+    // Âm thanh không được lưu. Ảnh cũ chỉ bị thay khi ảnh mới không nhỏ hơn.
+    void insert(const FrameData &frame, int64_t prevPts);
+    bool find(int64_t pts, FrameData &frame);
+    bool findPrevious(int64_t pts, FrameData &frame);
+    bool findNext(int64_t pts, FrameData &frame);
+    void clear();
+
+    int count() const;
+    qint64 bytes() const;
+
+private:
+    struct Entry {
+        FrameData frame;
+        qint64 bytes = 0;
+        int64_t prevPts = AV_NOPTS_VALUE;
+        int64_t nextPts = AV_NOPTS_VALUE;
+        std::list<int64_t>::iterator lruPos;
+    };
+
+    bool lookup(int64_t pts, FrameData &frame);
+    void evict();
+
+    mutable QMutex m_mutex;
+    std::unordered_map<int64_t, Entry> m_entries;
+    std::list<int64_t> m_lru; // Đầu danh sách = vừa dùng gần nhất
+    qint64 m_maxBytes;
+    qint64 m_bytes = 0;
+};
+
+#endif // FRAMECACHE_H
@@ -0,0 +1,217 @@
+// frameindex.cpp - Version 1.4
+// Change-log:
+// - Version 1.4: cacheFilePath nhận thư mục con và đuôi file, dùng chung với cache ảnh thu nhỏ.
+// - Version 1.3: Log nạp/dựng chỉ mục frame (mỗi lần mở file) chuyển sang lcPerf.
+// - Version 1.2: Tách contentKey để cache ảnh thu nhỏ dùng chung.
+// - Version 1.1: Thêm keyframeAtOrAfter (dùng khi kéo thanh thời gian chỉ hiện keyframe).
+#include "frameindex.h"
+#include "perflog.h"
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <algorithm>
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+}
+
+namespace {
+const quint32 kIndexMagic = 0x46494458; // "FIDX"
+const quint32 kIndexVersion = 1;
+const qint64 kHashChunkSize = 64 * 1024;
+}
+
+std::shared_ptr<const FrameIndex> FrameIndex::loadOrBuild(const QString &filePath, const std::atomic<bool> &cancel)
+{
+    QFileInfo fileInfo(filePath);
+    QString cachePath = cacheFilePath(filePath, QStringLiteral("frameindex"), QStringLiteral(".idx"));
+    if (!cachePath.isEmpty()) {
+        if (auto cached = load(cachePath, fileInfo)) {
+            qCDebug(lcPerf) << "Frame index loaded from cache:" << cached->frameCount() << "frames";
+            return cached;
+        }
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    auto index = build(filePath, cancel);
+    if (!index) return nullptr;
+    qCDebug(lcPerf) << "Frame index built:" << index->frameCount() << "frames,"
+             << index->m_keyframes.size() << "keyframes in" << timer.elapsed() << "ms";
+    if (!cachePath.isEmpty()) {
+        index->save(cachePath, fileInfo);
+    }
+    return index;
+}
+
+std::shared_ptr<FrameIndex> FrameIndex::build(const QString &filePath, const std::atomic<bool> &cancel)
+{
+    AVFormatContext *formatContext = nullptr;
+    std::string filePathStr = filePath.toStdString();
+    if (avformat_open_input(&formatContext, filePathStr.c_str(), nullptr, nullptr) != 0) return nullptr;
+    if (avformat_find_stream_info(formatContext, nullptr) < 0) {
+        avformat_close_input(&formatContext);
+        return nullptr;
+    }
+    int streamIndex = av_find_best_stream(formatContext, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    if (streamIndex < 0) {
+        avformat_close_input(&formatContext);
+        return nullptr;
+    }
+    // Chỉ đọc packet của luồng video, bỏ qua các luồng khác ngay ở demuxer
+    for (unsigned int i = 0; i < formatContext->nb_streams; ++i) {
+        if (static_cast<int>(i) != streamIndex) formatContext->streams[i]->discard = AVDISCARD_ALL;
+    }
+
+    auto index = std::make_shared<FrameIndex>();
+    index->m_timeBase = formatContext->streams[streamIndex]->time_base;
+
+    AVPacket *packet = av_packet_alloc();
+    bool valid = true;
+    while (av_read_frame(formatContext, packet) >= 0) {
+        if (cancel) {
+            valid = false;
+            av_packet_unref(packet);
+            break;
+        }
+        if (packet->stream_index == streamIndex) {
+            int64_t pts = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+            if (pts == AV_NOPTS_VALUE) {
+                // Không có mốc thời gian thì chỉ mục không đáng tin cậy
+                valid = false;
+                av_packet_unref(packet);
+                break;
+            }
+            index->m_pts.push_back(pts);
+            if (packet->flags & AV_PKT_FLAG_KEY) index->m_keyframes.push_back(pts);
+        }
+        av_packet_unref(packet);
+    }
+    av_packet_free(&packet);
+    avformat_close_input(&formatContext);
+
+    if (!valid || index->m_pts.empty() || index->m_keyframes.empty()) return nullptr;
+
+    // Packet đến theo thứ tự giải mã; sắp lại theo thứ tự hiển thị
+    std::sort(index->m_pts.begin(), index->m_pts.end());
+    index->m_pts.erase(std::unique(index->m_pts.begin(), index->m_pts.end()), index->m_pts.end());
+    std::sort(index->m_keyframes.begin(), index->m_keyframes.end());
+    index->m_keyframes.erase(std::unique(index->m_keyframes.begin(), index->m_keyframes.end()), index->m_keyframes.end());
+    return index;
+}
+
+int FrameIndex::frameCount() const
+{
+    return static_cast<int>(m_pts.size());
+}
+
+AVRational FrameIndex::timeBase() const
+{
+    return m_timeBase;
+}
+
+int64_t FrameIndex::ptsAt(int frameNumber) const
+{
+    if (m_pts.empty()) return AV_NOPTS_VALUE;
+    return m_pts[qBound(0, frameNumber, frameCount() - 1)];
+}
+
+int FrameIndex::frameNumberForPts(int64_t pts) const
+{
+    auto it = std::upper_bound(m_pts.begin(), m_pts.end(), pts);
+    return static_cast<int>(it - m_pts.begin()) - 1;
+}
+
+int64_t FrameIndex::keyframeAtOrBefore(int64_t pts) const
+{
+    auto it = std::upper_bound(m_keyframes.begin(), m_keyframes.end(), pts);
+    if (it == m_keyframes.begin()) return AV_NOPTS_VALUE;
+    return *(it - 1);
+}
+
+int64_t FrameIndex::keyframeAtOrAfter(int64_t pts) const
+{
+    auto it = std::lower_bound(m_keyframes.begin(), m_keyframes.end(), pts);
+    if (it == m_keyframes.end()) return AV_NOPTS_VALUE;
+    return *it;
+}
+
+QString FrameIndex::contentKey(const QString &filePath)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) return QString();
+
+    // Hash đầu + cuối file và kích thước: đủ phân biệt file mà không phải đọc toàn bộ video
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(QFileInfo(filePath).absoluteFilePath().toUtf8());
+    hash.addData(QByteArray::number(file.size()));
+    hash.addData(file.read(kHashChunkSize));
+    if (file.size() > kHashChunkSize) {
+        file.seek(qMax(kHashChunkSize, file.size() - kHashChunkSize));
+        hash.addData(file.read(kHashChunkSize));
+    }
+    return QString::fromLatin1(hash.result().toHex());
+}
+
+QString FrameIndex::cacheFilePath(const QString &filePath, const QString &subDir, const QString &suffix)
+{
+    QString key = contentKey(filePath);
+    if (key.isEmpty()) return QString();
+    QString dirPath = QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).filePath(subDir);
+    if (!QDir().mkpath(dirPath)) return QString();
+    return QDir(dirPath).filePath(key + suffix);
+}
+
+std::shared_ptr<FrameIndex> FrameIndex::load(const QString &cachePath, const QFileInfo &fileInfo)
+{
+    QFile file(cachePath);
+    if (!file.open(QIODevice::ReadOnly)) return nullptr;
+    QDataStream in(&file);
+
+    quint32 magic = 0, version = 0;
+    qint64 mtime = 0, size = 0;
+    qint32 tbNum = 0, tbDen = 0;
+    in >> magic >> version >> mtime >> size >> tbNum >> tbDen;
+    if (magic != kIndexMagic || version != kIndexVersion) return nullptr;
+    // File video đã bị sửa sau khi tạo chỉ mục
+    if (mtime != fileInfo.lastModified().toMSecsSinceEpoch() || size != fileInfo.size()) return nullptr;
+
+    auto index = std::make_shared<FrameIndex>();
+    index->m_timeBase = {tbNum, tbDen};
+    quint32 frameCount = 0, keyframeCount = 0;
+    in >> frameCount;
+    index->m_pts.resize(frameCount);
+    for (quint32 i = 0; i < frameCount; ++i) {
+        qint64 pts; in >> pts; index->m_pts[i] = pts;
+    }
+    in >> keyframeCount;
+    index->m_keyframes.resize(keyframeCount);
+    for (quint32 i = 0; i < keyframeCount; ++i) {
+        qint64 pts; in >> pts; index->m_keyframes[i] = pts;
+    }
+    if (in.status() != QDataStream::Ok || index->m_pts.empty() || index->m_keyframes.empty()) return nullptr;
+    return index;
+}
+
+bool FrameIndex::save(const QString &cachePath, const QFileInfo &fileInfo) const
+{
+    QSaveFile file(cachePath);
+    if (!file.open(QIODevice::WriteOnly)) return false;
+    QDataStream out(&file);
+    out << kIndexMagic << kIndexVersion
+        << qint64(fileInfo.lastModified().toMSecsSinceEpoch()) << qint64(fileInfo.size())
+        << qint32(m_timeBase.num) << qint32(m_timeBase.den);
+    out << quint32(m_pts.size());
+    for (int64_t pts : m_pts) out << qint64(pts);
+    out << quint32(m_keyframes.size());
+    for (int64_t pts : m_keyframes) out << qint64(pts);
+    return file.commit();
+}
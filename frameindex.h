@@ -0,0 +1,49 @@
+// frameindex.h - Version 1.3
+// Chỉ mục frame/keyframe của luồng video, dựng bằng cách đọc packet một lượt (không giải mã).
+// Kết quả được lưu vào thư mục cache, khóa theo hash nội dung file và thời điểm sửa đổi.
+#ifndef FRAMEINDEX_H
+#define FRAMEINDEX_H
+
+#include <QString>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+extern "C" {
+#include <libavutil/rational.h>
+}
+
+class QFileInfo;
+
+class FrameIndex
+{
+public:
+    // Đọc từ cache nếu còn hợp lệ, nếu không thì dựng lại và ghi cache. Trả nullptr nếu thất bại/bị hủy.
+    static std::shared_ptr<const FrameIndex> loadOrBuild(const QString &filePath, const std::atomic<bool> &cancel);
+    // Đường dẫn file cache của video trong CacheLocation/subDir, đặt tên theo nội dung file (đường dẫn,
+    // kích thước, 64 KiB đầu/cuối) + suffix; rỗng nếu không đọc được file hoặc không tạo được thư mục
+    static QString cacheFilePath(const QString &filePath, const QString &subDir, const QString &suffix);
+
+    int frameCount() const;
+    AVRational timeBase() const;
+    // PTS (theo time base của luồng) của frame thứ frameNumber theo thứ tự hiển thị
+    int64_t ptsAt(int frameNumber) const;
+    // Số thứ tự của frame cuối cùng có pts <= pts; -1 nếu pts trước frame đầu tiên
+    int frameNumberForPts(int64_t pts) const;
+    // PTS của keyframe gần nhất không sau pts; AV_NOPTS_VALUE nếu không có
+    int64_t keyframeAtOrBefore(int64_t pts) const;
+    // PTS của keyframe gần nhất không trước pts; AV_NOPTS_VALUE nếu không có
+    int64_t keyframeAtOrAfter(int64_t pts) const;
+
+private:
+    static std::shared_ptr<FrameIndex> build(const QString &filePath, const std::atomic<bool> &cancel);
+    static std::shared_ptr<FrameIndex> load(const QString &cachePath, const QFileInfo &fileInfo);
+    bool save(const QString &cachePath, const QFileInfo &fileInfo) const;
+    static QString contentKey(const QString &filePath);
+
+    AVRational m_timeBase = {0, 1};
+    std::vector<int64_t> m_pts;       // Thứ tự hiển thị (đã sắp xếp)
+    std::vector<int64_t> m_keyframes; // Đã sắp xếp
+};
+
+#endif // FRAMEINDEX_H
@@ -0,0 +1,99 @@
+// framepool.cpp - Version 1.0
+#include "framepool.h"
+#include <QMutex>
+#include <QMutexLocker>
+#include <atomic>
+#include <vector>
+
+namespace {
+struct PoolBuffer {
+    uchar *data = nullptr;
+    qsizetype size = 0;
+    // Giữ State sống khi ảnh còn được tham chiếu sau khi FramePool đã bị hủy
+    std::shared_ptr<FramePool::State> owner;
+
+    ~PoolBuffer() { qFreeAligned(data); }
+};
+}
+
+struct FramePool::State {
+    QMutex mutex;
+    std::vector<PoolBuffer*> freeBuffers;
+    int maxFree = 0;
+    std::atomic<quint64> allocations = 0;
+
+    ~State() { qDeleteAll(freeBuffers); }
+};
+
+static void releasePoolBuffer(void *info)
+{
+    PoolBuffer *buffer = static_cast<PoolBuffer*>(info);
+    std::shared_ptr<FramePool::State> owner = std::move(buffer->owner);
+    {
+        QMutexLocker locker(&owner->mutex);
+        if (static_cast<int>(owner->freeBuffers.size()) < owner->maxFree) {
+            owner->freeBuffers.push_back(buffer);
+            return;
+        }
+    }
+    delete buffer;
+}
+
+FramePool::FramePool(int maxFreeBuffers) : m_state(std::make_shared<State>())
+{
+    m_state->maxFree = qMax(1, maxFreeBuffers);
+    // Đặt trước dung lượng để việc trả bộ đệm về pool không bao giờ cấp phát
+    m_state->freeBuffers.reserve(m_state->maxFree);
+}
+
+FramePool::~FramePool() = default;
+
+QImage FramePool::acquireImage(int width, int height, QImage::Format format)
+{
+    if (width <= 0 || height <= 0) return QImage();
+
+    // Căn dòng theo 64 byte để sws_scale dùng được đường SIMD
+    const int depthBytes = QImage::toPixelFormat(format).bitsPerPixel() / 8;
+    const qsizetype bytesPerLine = (qsizetype(width) * depthBytes + 63) & ~qsizetype(63);
+    const qsizetype needed = bytesPerLine * height;
+
+    PoolBuffer *buffer = nullptr;
+    {
+        QMutexLocker locker(&m_state->mutex);
+        auto &freeBuffers = m_state->freeBuffers;
+        for (auto it = freeBuffers.begin(); it != freeBuffers.end(); ++it) {
+            if ((*it)->size >= needed) {
+                buffer = *it;
+                freeBuffers.erase(it);
+                break;
+            }
+        }
+    }
+
+    if (!buffer) {
+        buffer = new PoolBuffer();
+        buffer->data = static_cast<uchar*>(qMallocAligned(needed, 64));
+        if (!buffer->data) { delete buffer; return QImage(); }
+        buffer->size = needed;
+        m_state->allocations++;
+    }
+    buffer->owner = m_state;
+
+    return QImage(buffer->data, width, height, bytesPerLine, format, releasePoolBuffer, buffer);
+}
+
+quint64 FramePool::allocationCount() const
+{
+    return m_state->allocations;
+}
+
+void FramePool::trim()
+{
+    std::vector<PoolBuffer*> toDelete;
+    {
+        QMutexLocker locker(&m_state->mutex);
+        toDelete.swap(m_state->freeBuffers);
+        m_state->freeBuffers.reserve(m_state->maxFree);
+    }
+    qDeleteAll(toDelete);
+}
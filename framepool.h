@@ -0,0 +1,30 @@
+// framepool.h - Version 1.0
+// Pool bộ đệm điểm ảnh dùng lại cho các QImage do VideoProcessor tạo ra.
+// Mỗi QImage trả về bọc một bộ đệm của pool; khi bản sao QImage cuối cùng bị hủy,
+// bộ đệm tự quay về pool (qua cleanup function của QImage) thay vì bị giải phóng.
+#ifndef FRAMEPOOL_H
+#define FRAMEPOOL_H
+
+#include <QImage>
+#include <memory>
+
+class FramePool
+{
+public:
+    explicit FramePool(int maxFreeBuffers = 32);
+    ~FramePool();
+
+    QImage acquireImage(int width, int height, QImage::Format format);
+
+    // Số lần phải cấp phát bộ đệm mới (pool không có sẵn bộ đệm phù hợp)
+    quint64 allocationCount() const;
+    // Giải phóng các bộ đệm đang rảnh (vd. khi đổi file có độ phân giải khác)
+    void trim();
+
+    struct State;
+
+private:
+    std::shared_ptr<State> m_state;
+};
+
+#endif // FRAMEPOOL_H
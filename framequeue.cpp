@@ -0,0 +1,138 @@
+// framequeue.cpp - Version 1.3
+// Change-log:
+// - Version 1.3: Thêm maxBytes(), frameBytes chuyển sang public (giới hạn bộ nhớ GOP khi phát ngược).
+// - Version 1.2: FrameData không còn mang âm thanh.
+// - Version 1.1: Thêm tryPeek.
+#include "framequeue.h"
+#include <QMutexLocker>
+
+FrameQueue::FrameQueue(int maxFrames, qint64 maxBytes)
+    : m_maxFrames(qMax(1, maxFrames)), m_maxBytes(qMax<qint64>(1, maxBytes))
+{
+    // Dành thêm 1 ô cho pushUnbounded để không phải cấp phát lại khi dừng producer
+    m_slots.resize(m_maxFrames + 1);
+}
+
+void FrameQueue::setLimits(int maxFrames, qint64 maxBytes)
+{
+    QMutexLocker locker(&m_mutex);
+    m_maxFrames = qMax(1, maxFrames);
+    m_maxBytes = qMax<qint64>(1, maxBytes);
+    if (static_cast<int>(m_slots.size()) < m_maxFrames + 1 || m_count == 0) {
+        relayout(qMax(m_maxFrames + 1, m_count));
+    }
+    m_notFull.wakeAll();
+}
+
+bool FrameQueue::push(const FrameData &frame)
+{
+    const qint64 size = frameBytes(frame);
+    QMutexLocker locker(&m_mutex);
+    while (!m_aborted && isFull(size)) {
+        m_notFull.wait(&m_mutex);
+    }
+    if (m_aborted) return false;
+
+    m_slots[(m_head + m_count) % m_slots.size()] = frame;
+    m_count++;
+    m_bytes += size;
+    return true;
+}
+
+void FrameQueue::pushUnbounded(const FrameData &frame)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_count >= static_cast<int>(m_slots.size())) {
+        relayout(m_count + 1);
+    }
+    m_slots[(m_head + m_count) % m_slots.size()] = frame;
+    m_count++;
+    m_bytes += frameBytes(frame);
+}
+
+bool FrameQueue::tryPop(FrameData &frame)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_count == 0) return false;
+
+    frame = std::move(m_slots[m_head]);
+    m_slots[m_head] = FrameData();
+    m_head = (m_head + 1) % m_slots.size();
+    m_count--;
+    m_bytes -= frameBytes(frame);
+    m_notFull.wakeAll();
+    return true;
+}
+
+bool FrameQueue::tryPeek(FrameData &frame) const
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_count == 0) return false;
+    frame = m_slots[m_head];
+    return true;
+}
+
+void FrameQueue::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    for (FrameData &slot : m_slots) {
+        slot = FrameData();
+    }
+    m_head = 0;
+    m_count = 0;
+    m_bytes = 0;
+    m_notFull.wakeAll();
+}
+
+void FrameQueue::abort()
+{
+    QMutexLocker locker(&m_mutex);
+    m_aborted = true;
+    m_notFull.wakeAll();
+}
+
+void FrameQueue::reset()
+{
+    QMutexLocker locker(&m_mutex);
+    m_aborted = false;
+}
+
+int FrameQueue::count() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_count;
+}
+
+qint64 FrameQueue::bytes() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_bytes;
+}
+
+qint64 FrameQueue::maxBytes() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_maxBytes;
+}
+
+qint64 FrameQueue::frameBytes(const FrameData &frame)
+{
+    return frame.image.sizeInBytes();
+}
+
+bool FrameQueue::isFull(qint64 incomingBytes) const
+{
+    if (m_count >= m_maxFrames) return true;
+    // Luôn cho phép ít nhất 1 frame, kể cả khi 1 frame lớn hơn giới hạn bộ nhớ
+    return m_count > 0 && m_bytes + incomingBytes > m_maxBytes;
+}
+
+void FrameQueue::relayout(int capacity)
+{
+    std::vector<FrameData> slots(capacity);
+    for (int i = 0; i < m_count; ++i) {
+        slots[i] = std::move(m_slots[(m_head + i) % m_slots.size()]);
+    }
+    m_slots.swap(slots);
+    m_head = 0;
+}
@@ -0,0 +1,53 @@
+// framequeue.h - Version 1.3
+// Hàng đợi vòng (ring buffer) có giới hạn giữa luồng giải mã trước (producer)
+// và timer trình chiếu của VideoWorker (consumer).
+#ifndef FRAMEQUEUE_H
+#define FRAMEQUEUE_H
+
+#include <QMutex>
+#include <QWaitCondition>
+#include <vector>
+#include "videoprocessor.h"
+
+class FrameQueue
+{
+public:
+    explicit FrameQueue(int maxFrames = 8, qint64 maxBytes = 256ll * 1024 * 1024);
+
+    // Giới hạn theo số frame và theo tổng dung lượng ảnh
+    void setLimits(int maxFrames, qint64 maxBytes);
+
+    // Chặn khi hàng đợi đầy. Trả về false nếu bị abort() trong lúc chờ.
+    bool push(const FrameData &frame);
+    // Không chặn, bỏ qua giới hạn: dùng để trả lại frame mà producer chưa kịp đẩy vào
+    void pushUnbounded(const FrameData &frame);
+    bool tryPop(FrameData &frame);
+    // Xem frame đầu hàng đợi mà không lấy ra (để lên lịch theo pts)
+    bool tryPeek(FrameData &frame) const;
+
+    void clear();
+    void abort();  // Đánh thức producer đang chờ chỗ trống
+    void reset();  // Xóa trạng thái abort để dùng lại
+
+    int count() const;
+    qint64 bytes() const;
+    qint64 maxBytes() const;
+    // Dung lượng ảnh của một frame theo cách hàng đợi tính giới hạn
+    static qint64 frameBytes(const FrameData &frame);
+
+private:
+    bool isFull(qint64 incomingBytes) const;
+    void relayout(int capacity);
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_notFull;
+    std::vector<FrameData> m_slots;
+    int m_head = 0;
+    int m_count = 0;
+    int m_maxFrames;
+    qint64 m_maxBytes;
+    qint64 m_bytes = 0;
+    bool m_aborted = false;
+};
+
+#endif // FRAMEQUEUE_H
@@ -0,0 +1,232 @@
+// imagestore.cpp - Version 1.1
+// Change-log:
+// - Version 1.1:
+//   - clear() xóa cả các file của kho trong thư mục tạm (store_*, ảnh chụp loạt).
+//   - File thuộc kho khi nằm trong thư mục tạm (so với đường dẫn có dấu '/'), không nhầm thư mục
+//     cùng tiền tố tên.
+//   - Ảnh đẩy ra đĩa được ghi nền, không tính vào số ảnh đang ghi trên PlayerPanel.
+#include "imagestore.h"
+#include "encodepipeline.h"
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QMutexLocker>
+#include <QUuid>
+#include <algorithm>
+#include <vector>
+
+ImageStore::ImageStore(qint64 memoryBudget) : m_budget(qMax<qint64>(0, memoryBudget))
+{
+}
+
+void ImageStore::setMemoryBudget(qint64 bytes)
+{
+    QMutexLocker locker(&m_mutex);
+    m_budget = qMax<qint64>(0, bytes);
+    evictLocked();
+}
+
+void ImageStore::setSpillDirectory(const QString &dirPath)
+{
+    QMutexLocker locker(&m_mutex);
+    m_spillDir = dirPath;
+}
+
+void ImageStore::setEncodePipeline(std::shared_ptr<EncodePipeline> pipeline)
+{
+    QMutexLocker locker(&m_mutex);
+    m_pipeline = std::move(pipeline);
+}
+
+QString ImageStore::insert(const QImage &image)
+{
+    if (image.isNull()) return QString();
+    const QString id = QUuid::createUuid().toString(QUuid::WithoutBraces);
+    QMutexLocker locker(&m_mutex);
+    Entry &entry = m_entries[id];
+    setImageLocked(entry, image);
+    touchLocked(entry);
+    evictLocked();
+    return id;
+}
+
+QString ImageStore::insertFile(const QString &filePath, const QImage &decoded)
+{
+    if (filePath.isEmpty()) return QString();
+    const QString id = QUuid::createUuid().toString(QUuid::WithoutBraces);
+    QMutexLocker locker(&m_mutex);
+    Entry &entry = m_entries[id];
+    entry.filePath = filePath;
+    entry.fileValid = true;
+    if (!decoded.isNull()) setImageLocked(entry, decoded);
+    touchLocked(entry);
+    evictLocked();
+    return id;
+}
+
+QImage ImageStore::image(const QString &id)
+{
+    QString filePath;
+    quint64 version = 0;
+    {
+        QMutexLocker locker(&m_mutex);
+        auto it = m_entries.find(id);
+        if (it == m_entries.end()) return QImage();
+        touchLocked(*it);
+        if (!it->image.isNull()) return it->image;
+        if (!it->fileValid) return QImage();
+        filePath = it->filePath;
+        version = it->version;
+    }
+
+    // Giải mã ngoài khóa: luồng mã hóa có thể đang báo ghi xong cho ảnh khác
+    QImage loaded(filePath);
+    if (loaded.isNull()) {
+        qWarning() << "ImageStore: cannot reload" << filePath;
+        return QImage();
+    }
+
+    QMutexLocker locker(&m_mutex);
+    auto it = m_entries.find(id);
+    if (it == m_entries.end() || it->version != version) return loaded;
+    if (it->image.isNull()) setImageLocked(*it, loaded);
+    touchLocked(*it);
+    evictLocked();
+    return it->image;
+}
+
+void ImageStore::replace(const QString &id, const QImage &image)
+{
+    if (image.isNull()) return;
+    QString staleFile;
+    {
+        QMutexLocker locker(&m_mutex);
+        auto it = m_entries.find(id);
+        if (it == m_entries.end()) return;
+        it->version++;
+        if (it->fileValid && ownsFileLocked(it->filePath)) staleFile = it->filePath;
+        it->fileValid = false;
+        it->spilling = false;
+        setImageLocked(*it, image);
+        touchLocked(*it);
+        evictLocked();
+    }
+    if (!staleFile.isEmpty()) QFile::remove(staleFile);
+}
+
+void ImageStore::remove(const QString &id)
+{
+    QString staleFile;
+    {
+        QMutexLocker locker(&m_mutex);
+        auto it = m_entries.find(id);
+        if (it == m_entries.end()) return;
+        if (it->fileValid && ownsFileLocked(it->filePath)) staleFile = it->filePath;
+        m_residentBytes -= it->image.sizeInBytes();
+        m_entries.erase(it);
+    }
+    if (!staleFile.isEmpty()) QFile::remove(staleFile);
+}
+
+void ImageStore::clear()
+{
+    QStringList staleFiles;
+    {
+        QMutexLocker locker(&m_mutex);
+        for (const Entry &entry : std::as_const(m_entries)) {
+            if (entry.fileValid && ownsFileLocked(entry.filePath)) staleFiles.append(entry.filePath);
+        }
+        m_entries.clear();
+        m_residentBytes = 0;
+    }
+    // Ảnh đang ghi dở sẽ bị xóa trong onSpilled vì ID không còn
+    for (const QString &filePath : std::as_const(staleFiles)) QFile::remove(filePath);
+}
+
+qint64 ImageStore::residentBytes() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_residentBytes;
+}
+
+bool ImageStore::ownsFileLocked(const QString &filePath) const
+{
+    // File trong thư mục tạm là bản riêng của ứng dụng (ảnh chụp loạt, bản sao ảnh thêm vào, ảnh đã ghi ra)
+    return !m_spillDir.isEmpty() && filePath.startsWith(m_spillDir + QLatin1Char('/'));
+}
+
+void ImageStore::touchLocked(Entry &entry)
+{
+    entry.lastUse = ++m_useCounter;
+}
+
+void ImageStore::setImageLocked(Entry &entry, const QImage &image)
+{
+    m_residentBytes += image.sizeInBytes() - entry.image.sizeInBytes();
+    entry.image = image;
+}
+
+void ImageStore::evictLocked()
+{
+    if (m_residentBytes <= m_budget) return;
+
+    // Ứng viên theo thứ tự ít dùng gần đây nhất; ảnh đang ghi ra đĩa sẽ tự rời bộ nhớ khi ghi xong
+    std::vector<std::pair<quint64, QString>> candidates;
+    qint64 excess = m_residentBytes - m_budget;
+    for (auto it = m_entries.cbegin(); it != m_entries.cend(); ++it) {
+        if (it->image.isNull()) continue;
+        if (it->spilling) excess -= it->image.sizeInBytes();
+        else candidates.emplace_back(it->lastUse, it.key());
+    }
+    std::sort(candidates.begin(), candidates.end());
+    // Ảnh vừa dùng nhất luôn được giữ lại, kể cả khi một mình nó lớn hơn ngân sách
+    if (!candidates.empty()) candidates.pop_back();
+
+    for (const auto &candidate : candidates) {
+        if (excess <= 0) break;
+        Entry &entry = m_entries[candidate.second];
+        const qint64 bytes = entry.image.sizeInBytes();
+        if (entry.fileValid) {
+            m_residentBytes -= bytes;
+            entry.image = QImage();
+            excess -= bytes;
+            continue;
+        }
+        if (!m_pipeline || m_spillDir.isEmpty()) continue;
+
+        // Không chặn: hàng đợi mã hóa đầy thì ảnh ở lại bộ nhớ đến lần đẩy sau
+        std::weak_ptr<ImageStore> weakSelf = weak_from_this();
+        const QString id = candidate.second;
+        const quint64 version = entry.version;
+        const quint64 lastUse = entry.lastUse;
+        const bool accepted = m_pipeline->trySubmit(entry.image, QDir(m_spillDir).filePath("store_" + id),
+            [weakSelf, id, version, lastUse](bool ok, const QString &filePath) {
+                if (auto self = weakSelf.lock()) self->onSpilled(id, version, lastUse, ok, filePath);
+                else QFile::remove(filePath);
+            }, true);
+        if (!accepted) break;
+        entry.spilling = true;
+        excess -= bytes;
+    }
+}
+
+void ImageStore::onSpilled(const QString &id, quint64 version, quint64 lastUse, bool ok, const QString &filePath)
+{
+    QMutexLocker locker(&m_mutex);
+    auto it = m_entries.find(id);
+    // Ảnh đã bị xóa hoặc thay trong lúc ghi: file vừa ghi không còn dùng
+    if (it == m_entries.end() || it->version != version) {
+        locker.unlock();
+        if (ok) QFile::remove(filePath);
+        return;
+    }
+    it->spilling = false;
+    if (!ok) return;
+    it->filePath = filePath;
+    it->fileValid = true;
+    // Chỉ bỏ khỏi bộ nhớ nếu không được dùng lại trong lúc ghi
+    if (it->lastUse == lastUse && m_residentBytes > m_budget) {
+        m_residentBytes -= it->image.sizeInBytes();
+        it->image = QImage();
+    }
+}
@@ -0,0 +1,70 @@
+// imagestore.h - Version 1.1
+// Kho ảnh dùng chung cho thư viện: giữ ảnh đã giải mã theo ID trong một ngân sách bộ nhớ.
+// Vượt ngân sách thì ảnh ít dùng nhất bị đẩy ra: ảnh đã có file trên đĩa chỉ bị bỏ khỏi bộ nhớ,
+// ảnh chỉ có trong bộ nhớ (ảnh chụp, ảnh đã cắt) được ghi ra thư mục tạm qua EncodePipeline trước.
+// Ảnh bị đẩy ra được đọc lại từ đĩa ở lần truy cập sau.
+// QImage dùng chung dữ liệu nên ảnh trả về vẫn hợp lệ sau khi bị đẩy khỏi kho; ngân sách chỉ tính
+// phần kho đang giữ, không tính các bản sao mà nơi khác (ViewPanel, CropDialog) còn giữ.
+#ifndef IMAGESTORE_H
+#define IMAGESTORE_H
+
+#include <QHash>
+#include <QImage>
+#include <QMutex>
+#include <QString>
+#include <memory>
+
+class EncodePipeline;
+
+class ImageStore : public std::enable_shared_from_this<ImageStore>
+{
+public:
+    explicit ImageStore(qint64 memoryBudget = 512ll * 1024 * 1024);
+
+    void setMemoryBudget(qint64 bytes);
+    // Nơi ghi ảnh bị đẩy ra và hàng đợi mã hóa dùng để ghi
+    void setSpillDirectory(const QString &dirPath);
+    void setEncodePipeline(std::shared_ptr<EncodePipeline> pipeline);
+
+    // Ảnh chỉ có trong bộ nhớ; trả về ID
+    QString insert(const QImage &image);
+    // Ảnh đã có trên đĩa; decoded (nếu có) là bản đã giải mã sẵn để khỏi đọc lại ngay
+    QString insertFile(const QString &filePath, const QImage &decoded = QImage());
+    // Ảnh theo ID, đọc lại từ đĩa nếu đã bị đẩy ra; ảnh rỗng nếu ID không tồn tại
+    QImage image(const QString &id);
+    // Thay ảnh (vd. sau khi cắt); file cũ trên đĩa không còn đúng
+    void replace(const QString &id, const QImage &image);
+    // Xóa khỏi kho; file tương ứng trong thư mục tạm cũng bị xóa
+    void remove(const QString &id);
+    // Xóa toàn bộ kho cùng các file của kho trong thư mục tạm (ảnh đã đẩy ra, ảnh chụp loạt)
+    void clear();
+
+    qint64 residentBytes() const;
+
+private:
+    struct Entry {
+        QImage image;         // Rỗng khi đã bị đẩy ra
+        QString filePath;     // File trên đĩa, rỗng nếu chưa từng ghi
+        bool fileValid = false;
+        bool spilling = false;
+        quint64 lastUse = 0;
+        quint64 version = 0;  // Tăng mỗi lần replace
+    };
+
+    // Gọi khi đang giữ m_mutex
+    bool ownsFileLocked(const QString &filePath) const;
+    void touchLocked(Entry &entry);
+    void setImageLocked(Entry &entry, const QImage &image);
+    void evictLocked();
+    void onSpilled(const QString &id, quint64 version, quint64 lastUse, bool ok, const QString &filePath);
+
+    mutable QMutex m_mutex;
+    QHash<QString, Entry> m_entries;
+    std::shared_ptr<EncodePipeline> m_pipeline;
+    QString m_spillDir;
+    qint64 m_budget;
+    qint64 m_residentBytes = 0;
+    quint64 m_useCounter = 0;
+};
+
+#endif // IMAGESTORE_H
@@ -1,5 +1,54 @@
-// mainwindow.cpp - Version 9.0 (Hoàn thiện Mute & DragDrop)
+// mainwindow.cpp - Version 11.1 (Báo trạng thái thiết bị âm thanh cho VideoWorker)
 // Change-log:
+// - Version 11.1: Nối AudioOutput::outputAvailableChanged tới VideoWorker::setAudioOutputAvailable.
+// - Version 11.0: Ảnh chụp loạt được đưa thẳng vào ImageStore từ frame đã giải mã, không đọc lại file PNG
+//   trên luồng GUI.
+// - Version 10.9: Ảnh ghép lớn xuất PNG dùng mức nén pngCompression như ảnh chụp.
+// - Version 10.8:
+//   - Ảnh ghép lớn hơn tiledExportMegapixels (QSettings) được TiledCompositor ghi theo tile trên luồng nền
+//     (PNG theo dải hàng hoặc TIFF dạng tile), có hộp thoại tiến độ và hủy được.
+// - Version 10.7: Mở video mới xóa thư viện qua SidePanel::clearLibrary (giữ đồng bộ ảnh ghép).
+// - Version 10.6:
+//   - Ảnh chụp vào thẳng ImageStore và thư viện, không còn ghi PNG ra thư mục tạm rồi đọc lại để làm
+//     ảnh thu nhỏ. Kho chỉ ghi ảnh ra đĩa khi vượt ngân sách bộ nhớ (libraryMemoryMB trong QSettings).
+//   - Ảnh từ file (chụp loạt, thêm/thả vào thư viện) được giải mã một lần rồi giữ trong kho.
+// - Version 10.5:
+//   - Ảnh chụp được ghi qua EncodePipeline (QThreadPool riêng, hàng đợi có giới hạn) thay vì mỗi lần
+//     bấm lại đẩy một tác vụ vào QThreadPool chung. Hàng đợi đầy thì ảnh chụp bị từ chối và báo trên PlayerPanel.
+//   - Số luồng, giới hạn hàng đợi, định dạng (PNG/BMP) và mức nén PNG đọc/ghi trong QSettings.
+// - Version 10.4:
+//   - Chụp loạt theo khoảng vào/ra của PlayerPanel; ảnh được đưa vào thư viện ngay khi mã hóa xong.
+//   - Phím I / O đặt điểm vào / ra.
+// - Version 10.3:
+//   - Chụp ảnh luôn lấy frame gốc từ decoder (VideoWorker::processCapture) thay vì ảnh đang hiển thị.
+//   - Đọc/ghi chất lượng chuyển đổi khi chụp (captureQuality).
+// - Version 10.2:
+//   - Âm lượng 0 báo VideoWorker tắt hẳn luồng âm thanh (không đọc/giải mã packet âm thanh).
+// - Version 10.1:
+//   - Âm thanh do AudioOutput (luồng riêng, QAudioSink chế độ pull) phát; luồng giao diện không còn
+//     ghi âm thanh trong onFrameReady.
+// - Version 10.0:
+//   - Báo vị trí âm thanh đang phát (đã trừ phần còn trong bộ đệm của QAudioSink) cho đồng hồ chủ
+//     của VideoWorker; hiện độ lệch A/V và số frame bị bỏ trên PlayerPanel.
+// - Version 9.9:
+//   - Sau khi mở file, trích ảnh thu nhỏ ở nền (ThumbnailGenerator) cho thanh thời gian.
+// - Version 9.8:
+//   - Kéo thanh thời gian gọi VideoWorker::postSeek thay vì xếp hàng mỗi lần tua qua signal.
+// - Version 9.7:
+//   - Thêm phát ngược (nút trên PlayerPanel hoặc Shift+Space).
+// - Version 9.6:
+//   - Đọc/ghi giới hạn bộ nhớ của bộ đệm frame (dùng cho lùi từng frame).
+// - Version 9.5:
+//   - Nối yêu cầu nhảy tới frame của PlayerPanel và tổng số frame từ VideoWorker.
+// - Version 9.4:
+//   - Gửi kích thước hiển thị và trạng thái tua cho VideoWorker.
+//   - Khi frame đang hiển thị là bản thu nhỏ, yêu cầu worker giải mã frame gốc để chụp.
+// - Version 9.3:
+//   - Báo cho VideoWidget dùng co giãn nhanh khi phát/tua, mượt khi dừng.
+// - Version 9.2:
+//   - Đọc/ghi độ sâu và giới hạn bộ nhớ của bộ đệm giải mã trước.
+// - Version 9.1:
+//   - Đọc/ghi chế độ giải mã đa luồng trong QSettings và gửi cho VideoWorker.
 // - Version 9.0:
 //   - Hoàn thiện chức năng cho nút Mute.
 //   - Cải tiến Drag-and-Drop: Chấp nhận file ở bất kỳ đâu trên cửa sổ
@@ -13,6 +62,11 @@
 #include "librarywidget.h" 
 #include "videoworker.h"
 #include "videowidget.h"
+#include "thumbnailgenerator.h"
+#include "audiooutput.h"
+#include "encodepipeline.h"
+#include "imagestore.h"
+#include "tiledcompositor.h"
 
 #include <QSplitter>
 #include <QFileDialog>
@@ -25,7 +79,6 @@
 #include <QUrl>
 #include <QFileInfo>
 #include <QDir>
-#include <QAudioSink>
 #include <QMediaDevices>
 #include <QThread>
 #include <QStandardPaths>
@@ -38,9 +91,13 @@
 #include <QSpinBox>  
 #include <QtConcurrent>
 #include <QThreadPool> 
+#include <QFutureWatcher>
+#include <QProgressDialog>
 
 Q_DECLARE_METATYPE(VideoProcessor::AudioParams)
 Q_DECLARE_METATYPE(AVRational)
+Q_DECLARE_METATYPE(VideoProcessor::DecoderThreading)
+Q_DECLARE_METATYPE(VideoProcessor::ConversionQuality)
 Q_DECLARE_METATYPE(QListWidgetItem*)
 
 MainWindow::MainWindow(QWidget *parent)
@@ -48,9 +105,13 @@ MainWindow::MainWindow(QWidget *parent)
 {
     qRegisterMetaType<VideoProcessor::AudioParams>();
     qRegisterMetaType<AVRational>();
+    qRegisterMetaType<VideoProcessor::DecoderThreading>();
+    qRegisterMetaType<VideoProcessor::ConversionQuality>();
     qRegisterMetaType<QListWidgetItem*>();
 
     setupUi();
+    m_thumbnailGenerator = new ThumbnailGenerator(this);
+    connect(m_thumbnailGenerator, &ThumbnailGenerator::thumbnailReady, m_playerPanel, &PlayerPanel::addThumbnail);
     setupVideoWorker();
     setupTempDirectory();
     loadSettings();
@@ -65,7 +126,12 @@ MainWindow::~MainWindow()
     m_videoThread->quit();
     m_videoThread->wait();
 
-    cleanupAudio();
+    // QAudioSink phải được hủy trên luồng của nó
+    QMetaObject::invokeMethod(m_audioOutput.get(), &AudioOutput::stop, Qt::BlockingQueuedConnection);
+    m_audioThread->quit();
+    m_audioThread->wait();
+    // Chụp loạt đã bị hủy qua requestStop; chờ các ảnh đang ghi trước khi xóa thư mục tạm
+    m_encodePipeline->waitForDone();
     cleanupTempDirectory();
 }
 
@@ -89,23 +155,32 @@ void MainWindow::setupUi()
     // --- Connections ---
     connect(m_playerPanel, &PlayerPanel::openFileClicked, this, &MainWindow::onOpenFile);
     connect(m_playerPanel, &PlayerPanel::playPauseClicked, this, &MainWindow::onPlayPause);
+    connect(m_playerPanel, &PlayerPanel::reversePlayClicked, this, &MainWindow::onPlayReverse);
     connect(m_playerPanel, &PlayerPanel::nextFrameClicked, this, [this](){ emit requestNextFrame(); });
     connect(m_playerPanel, &PlayerPanel::prevFrameClicked, this, [this](){ emit requestPrevFrame(); });
     connect(m_playerPanel, &PlayerPanel::captureClicked, this, &MainWindow::onCapture);
     connect(m_playerPanel, &PlayerPanel::captureAndExportClicked, this, &MainWindow::onCaptureAndExport);
     connect(m_playerPanel, &PlayerPanel::toggleRightPanelClicked, this, &MainWindow::onToggleRightPanel);
-    connect(m_playerPanel, &PlayerPanel::timelinePressed, this, [this](){ m_isScrubbing = true; });
+    connect(m_playerPanel, &PlayerPanel::timelinePressed, this, [this](){
+        m_isScrubbing = true;
+        updateVideoScalingMode();
+        emit requestScrubbing(true);
+    });
+    connect(m_playerPanel, &PlayerPanel::frameSeekRequested, this, &MainWindow::requestSeekToFrame);
     connect(m_playerPanel, &PlayerPanel::timelineReleased, this, &MainWindow::onTimelineReleased);
     connect(m_playerPanel, &PlayerPanel::timelineMoved, this, &MainWindow::onTimelineMoved);
     connect(m_playerPanel, &PlayerPanel::muteClicked, this, &MainWindow::onMuteClicked);
     connect(m_playerPanel, &PlayerPanel::volumeChanged, this, &MainWindow::onVolumeChanged);
+    connect(m_playerPanel, &PlayerPanel::burstCaptureRequested, this, [this](qint64 inUs, qint64 outUs, int stride) {
+        emit requestBurstCapture(inUs, outUs, stride, m_tempPath);
+    });
+    // Gọi trực tiếp: chỉ đặt cờ atomic, vòng giải mã chụp loạt kiểm tra giữa các frame
+    connect(m_playerPanel, &PlayerPanel::burstCancelRequested, this, [this]() { m_videoWorker->cancelBurstCapture(); });
 
     connect(m_sidePanel, &SidePanel::exportImageRequested, this, &MainWindow::onExportImage);
+    connect(m_sidePanel, &SidePanel::exportTiledRequested, this, &MainWindow::onExportTiledComposite);
     connect(m_sidePanel, &SidePanel::addImagesToLibraryRequested, this, &MainWindow::onAddImagesToLibrary);
     connect(m_sidePanel, &SidePanel::newImagesDropped, this, &MainWindow::onImagesDroppedOnLibrary);
-    connect(m_sidePanel, &SidePanel::fileDeleted, this, [this](const QString& filePath){
-        m_capturedFramePaths.removeOne(filePath);
-    });
 
     connect(this, &MainWindow::playerStateChanged, m_playerPanel, &PlayerPanel::updatePlayerState);
     connect(this, &MainWindow::newFrameReady, this, [this](const FrameData& frameData, qint64 duration, double frameRate, const AVRational& timeBase){
@@ -120,19 +195,51 @@ void MainWindow::setupVideoWorker()
 {
     m_videoThread = std::make_unique<QThread>();
     m_videoWorker = std::make_unique<VideoWorker>();
+    m_encodePipeline = std::make_shared<EncodePipeline>();
+    m_videoWorker->setEncodePipeline(m_encodePipeline);
     m_videoWorker->moveToThread(m_videoThread.get());
+    connect(m_encodePipeline.get(), &EncodePipeline::queueChanged, m_playerPanel, &PlayerPanel::setEncodeQueueStatus);
+    m_imageStore = std::make_shared<ImageStore>();
+    m_imageStore->setEncodePipeline(m_encodePipeline);
+    m_sidePanel->setImageStore(m_imageStore);
+
+    m_audioThread = std::make_unique<QThread>();
+    m_audioOutput = std::make_unique<AudioOutput>(m_videoWorker->audioRing(), m_videoWorker->playbackClock());
+    m_audioOutput->moveToThread(m_audioThread.get());
+    connect(this, &MainWindow::requestStartAudio, m_audioOutput.get(), &AudioOutput::start);
+    connect(this, &MainWindow::requestStopAudio, m_audioOutput.get(), &AudioOutput::stop);
+    connect(this, &MainWindow::requestAudioVolume, m_audioOutput.get(), &AudioOutput::setVolume);
+    connect(m_videoWorker.get(), &VideoWorker::audioActiveChanged, m_audioOutput.get(), &AudioOutput::setActive);
+    connect(m_audioOutput.get(), &AudioOutput::outputAvailableChanged, m_videoWorker.get(), &VideoWorker::setAudioOutputAvailable);
 
     connect(this, &MainWindow::requestOpenFile, m_videoWorker.get(), &VideoWorker::processOpenFile);
-    connect(this, &MainWindow::requestSeek, m_videoWorker.get(), &VideoWorker::processSeek);
+    connect(this, &MainWindow::requestSeekToFrame, m_videoWorker.get(), &VideoWorker::processSeekToFrame);
     connect(this, &MainWindow::requestPlayPause, m_videoWorker.get(), &VideoWorker::processPlayPause);
+    connect(this, &MainWindow::requestPlayReverse, m_videoWorker.get(), &VideoWorker::processPlayReverse);
     connect(this, &MainWindow::requestNextFrame, m_videoWorker.get(), &VideoWorker::processNextFrame);
     connect(this, &MainWindow::requestPrevFrame, m_videoWorker.get(), &VideoWorker::processPrevFrame);
+    connect(this, &MainWindow::requestDecoderThreading, m_videoWorker.get(), &VideoWorker::setDecoderThreading);
+    connect(this, &MainWindow::requestDecodeAheadLimits, m_videoWorker.get(), &VideoWorker::setDecodeAheadLimits);
+    connect(this, &MainWindow::requestFrameCacheLimit, m_videoWorker.get(), &VideoWorker::setFrameCacheLimit);
+    connect(this, &MainWindow::requestScrubbing, m_videoWorker.get(), &VideoWorker::setScrubbing);
+    connect(this, &MainWindow::requestCapture, m_videoWorker.get(), &VideoWorker::processCapture);
+    connect(this, &MainWindow::requestCaptureQuality, m_videoWorker.get(), &VideoWorker::setCaptureQuality);
+    connect(this, &MainWindow::requestBurstCapture, m_videoWorker.get(), &VideoWorker::processBurstCapture);
+    connect(m_playerPanel->getVideoWidget(), &VideoWidget::displaySizeChanged, m_videoWorker.get(), &VideoWorker::setDisplaySize);
+    connect(this, &MainWindow::requestAudioMuted, m_videoWorker.get(), &VideoWorker::setAudioMuted);
     connect(this, &MainWindow::requestStop, m_videoWorker.get(), &VideoWorker::stop);
 
     connect(m_videoWorker.get(), &VideoWorker::fileOpened, this, &MainWindow::onFileOpened);
     connect(m_videoWorker.get(), &VideoWorker::frameReady, this, &MainWindow::onFrameReady);
+    connect(m_videoWorker.get(), &VideoWorker::frameCountChanged, m_playerPanel, &PlayerPanel::setTotalFrames);
+    connect(m_videoWorker.get(), &VideoWorker::captureReady, this, &MainWindow::onCaptureReady);
+    connect(m_videoWorker.get(), &VideoWorker::playbackStatsChanged, m_playerPanel, &PlayerPanel::setPlaybackStats);
+    connect(m_videoWorker.get(), &VideoWorker::burstFrameSaved, this, &MainWindow::addImageToList);
+    connect(m_videoWorker.get(), &VideoWorker::burstProgress, m_playerPanel, &PlayerPanel::setBurstProgress);
+    connect(m_videoWorker.get(), &VideoWorker::burstFinished, m_playerPanel, &PlayerPanel::setBurstFinished);
     
     m_videoThread->start();
+    m_audioThread->start(QThread::HighPriority);
 }
 
 void MainWindow::closeEvent(QCloseEvent *event)
@@ -150,6 +257,19 @@ void MainWindow::saveSettings()
     if (!m_currentVideoPath.isEmpty()) {
         settings.setValue("lastUsedDir", QFileInfo(m_currentVideoPath).absolutePath());
     }
+    settings.setValue("decoderThreading", static_cast<int>(m_decoderThreading));
+    settings.setValue("decoderThreadCount", m_decoderThreadCount);
+    settings.setValue("decodeAheadFrames", m_decodeAheadFrames);
+    settings.setValue("decodeAheadMemoryMB", m_decodeAheadMemoryMB);
+    settings.setValue("frameCacheMemoryMB", m_frameCacheMemoryMB);
+    settings.setValue("captureQuality", static_cast<int>(m_captureQuality));
+    settings.setValue("encodeWorkers", m_encodeWorkers);
+    settings.setValue("encodeQueueImages", m_encodeQueueImages);
+    settings.setValue("encodeQueueMemoryMB", m_encodeQueueMemoryMB);
+    settings.setValue("captureFormat", m_captureFormat);
+    settings.setValue("pngCompression", m_pngCompression);
+    settings.setValue("libraryMemoryMB", m_libraryMemoryMB);
+    settings.setValue("tiledExportMegapixels", m_tiledExportMegapixels);
 }
 
 void MainWindow::loadSettings()
@@ -167,6 +287,43 @@ void MainWindow::loadSettings()
         });
     }
     m_lastUsedDir = settings.value("lastUsedDir", QDir::homePath()).toString();
+
+    // Chế độ giải mã đa luồng: 0 = Auto (frame + slice), 1 = Frame, 2 = Slice, 3 = Tắt
+    int threading = settings.value("decoderThreading", static_cast<int>(VideoProcessor::ThreadingAuto)).toInt();
+    m_decoderThreading = static_cast<VideoProcessor::DecoderThreading>(qBound(0, threading, static_cast<int>(VideoProcessor::ThreadingOff)));
+    m_decoderThreadCount = settings.value("decoderThreadCount", 0).toInt();
+    emit requestDecoderThreading(m_decoderThreading, m_decoderThreadCount);
+
+    // Bộ đệm giải mã trước: số frame tối đa và dung lượng tối đa (MB)
+    m_decodeAheadFrames = qBound(1, settings.value("decodeAheadFrames", 8).toInt(), 120);
+    m_decodeAheadMemoryMB = qMax(16, settings.value("decodeAheadMemoryMB", 256).toInt());
+    emit requestDecodeAheadLimits(m_decodeAheadFrames, qint64(m_decodeAheadMemoryMB) * 1024 * 1024);
+    m_frameCacheMemoryMB = qMax(16, settings.value("frameCacheMemoryMB", 256).toInt());
+    emit requestFrameCacheLimit(qint64(m_frameCacheMemoryMB) * 1024 * 1024);
+
+    // Chất lượng chuyển đổi khi chụp: 0 = như hiển thị, 1 = chất lượng cao, 2 = chất lượng cao 16 bit
+    int captureQuality = settings.value("captureQuality", static_cast<int>(VideoProcessor::ConversionHighQuality)).toInt();
+    m_captureQuality = static_cast<VideoProcessor::ConversionQuality>(qBound(0, captureQuality, static_cast<int>(VideoProcessor::ConversionHighQuality16)));
+    emit requestCaptureQuality(m_captureQuality);
+
+    // Ghi ảnh chụp: số luồng (0 = tự chọn), giới hạn hàng đợi, định dạng 0 = PNG / 1 = BMP, mức nén PNG 0..9
+    m_encodeWorkers = qMax(0, settings.value("encodeWorkers", 0).toInt());
+    m_encodeQueueImages = qBound(1, settings.value("encodeQueueImages", 16).toInt(), 256);
+    m_encodeQueueMemoryMB = qMax(64, settings.value("encodeQueueMemoryMB", 512).toInt());
+    m_captureFormat = qBound(0, settings.value("captureFormat", 0).toInt(), static_cast<int>(EncodePipeline::FormatBmp));
+    m_pngCompression = qBound(0, settings.value("pngCompression", 1).toInt(), 9);
+    m_encodePipeline->setWorkerCount(m_encodeWorkers);
+    m_encodePipeline->setLimits(m_encodeQueueImages, qint64(m_encodeQueueMemoryMB) * 1024 * 1024);
+    m_encodePipeline->setFormat(static_cast<EncodePipeline::Format>(m_captureFormat));
+    m_encodePipeline->setPngCompression(m_pngCompression);
+
+    // Ngân sách bộ nhớ cho ảnh đã giải mã của thư viện (MB); vượt quá thì ảnh ít dùng được ghi ra đĩa
+    m_libraryMemoryMB = qMax(64, settings.value("libraryMemoryMB", 512).toInt());
+    m_imageStore->setMemoryBudget(qint64(m_libraryMemoryMB) * 1024 * 1024);
+
+    // Ảnh ghép lớn hơn ngưỡng này (megapixel) được xuất theo tile thay vì dựng cả ảnh; 0 = tắt
+    m_tiledExportMegapixels = qMax(0, settings.value("tiledExportMegapixels", 64).toInt());
+    m_sidePanel->setTiledExportThreshold(qint64(m_tiledExportMegapixels) * 1000 * 1000);
 }
 
 void MainWindow::setupTempDirectory()
@@ -176,6 +333,7 @@ void MainWindow::setupTempDirectory()
     if (!dir.exists()) {
         dir.mkpath(".");
     }
+    m_imageStore->setSpillDirectory(m_tempPath);
 }
 
 void MainWindow::cleanupTempDirectory()
@@ -194,29 +352,24 @@ void MainWindow::onFileOpened(bool success, VideoProcessor::AudioParams params,
         m_frameRate = frameRate;
         m_duration = duration;
         m_timeBase = timeBase;
+        m_playerPanel->resetThumbnails(duration);
+        m_thumbnailGenerator->start(m_currentVideoPath, duration);
         
         cleanupAudio();
         if(params.isValid) {
-            QAudioFormat format;
-            format.setSampleRate(params.sample_rate);
-            format.setChannelCount(params.channels);
-            format.setSampleFormat(QAudioFormat::Int16);
-            
             const auto& devices = QMediaDevices::defaultAudioOutput();
             if(!devices.isDefault()) {
                  QMessageBox::warning(this, "Lỗi Âm thanh", "Không tìm thấy thiết bị âm thanh mặc định.");
             } else {
-                m_audioSink = new QAudioSink(devices, format);
-                // Tăng kích thước buffer để giảm giật
-                int bufferSize = params.sample_rate * params.channels * (16 / 8) * 2.0; 
-                m_audioSink->setBufferSize(bufferSize);
-                m_audioDevice = m_audioSink->start();
+                emit requestStartAudio(params.sample_rate, params.channels);
                 
                 // Khôi phục lại âm lượng cuối cùng
                 m_playerPanel->setVolume(m_lastVolume * 100);
             }
         }
     } else {
+        m_thumbnailGenerator->cancel();
+        m_playerPanel->resetThumbnails(0);
         QMessageBox::warning(this, "Lỗi", "Không thể mở file video: " + m_currentVideoPath);
     }
 }
@@ -224,9 +377,6 @@ void MainWindow::onFileOpened(bool success, VideoProcessor::AudioParams params,
 void MainWindow::onFrameReady(const FrameData &frameData)
 {
     emit newFrameReady(frameData, m_duration, m_frameRate, m_timeBase);
-    if(m_audioDevice && !frameData.audioData.isEmpty()) {
-        m_audioDevice->write(frameData.audioData);
-    }
 }
 
 // === GIẢI PHÁP: Cải tiến Kéo-Thả ===
@@ -281,7 +431,11 @@ void MainWindow::keyPressEvent(QKeyEvent *event)
     }
     switch (event->key()) {
     case Qt::Key_Space: 
-        onPlayPause(); 
+        if (event->modifiers() & Qt::ShiftModifier) {
+            onPlayReverse();
+        } else {
+            onPlayPause();
+        }
         event->accept();
         break;
     case Qt::Key_Right: 
@@ -292,6 +446,14 @@ void MainWindow::keyPressEvent(QKeyEvent *event)
         emit requestPrevFrame();
         event->accept();
         break;
+    case Qt::Key_I:
+        m_playerPanel->markIn();
+        event->accept();
+        break;
+    case Qt::Key_O:
+        m_playerPanel->markOut();
+        event->accept();
+        break;
     default: 
         QMainWindow::keyPressEvent(event);
     }
@@ -304,9 +466,7 @@ void MainWindow::openVideoFile(const QString& filePath)
 
     m_currentVideoPath = filePath;
     m_sidePanel->getExportPanel()->setSavePath(QFileInfo(filePath).absolutePath());
-    m_sidePanel->getLibraryWidget()->clear();
-    m_capturedFramePaths.clear();
-    m_sidePanel->getViewPanel()->setImages({});
+    m_sidePanel->clearLibrary();
     emit requestOpenFile(filePath);
 }
 
@@ -321,37 +481,60 @@ void MainWindow::onOpenFile()
 
 void MainWindow::onPlayPause()
 {
+    // Đang phát ngược thì Space dừng lại
     m_isPlaying = !m_isPlaying;
+    m_isPlayingReverse = false;
     m_playerPanel->setPlayPauseButtonIcon(m_isPlaying);
+    m_playerPanel->setReversePlayButtonIcon(false);
+    updateVideoScalingMode();
     emit requestPlayPause(m_isPlaying);
     this->setFocus();
 }
 
+void MainWindow::onPlayReverse()
+{
+    m_isPlayingReverse = !m_isPlayingReverse;
+    m_isPlaying = m_isPlayingReverse;
+    m_playerPanel->setPlayPauseButtonIcon(false);
+    m_playerPanel->setReversePlayButtonIcon(m_isPlayingReverse);
+    updateVideoScalingMode();
+    emit requestPlayReverse(m_isPlayingReverse);
+    this->setFocus();
+}
+
 void MainWindow::onCapture()
 {
-    QImage currentFrame = m_playerPanel->getVideoWidget()->getCurrentImage();
-    if (!currentFrame.isNull()) {
-        QThreadPool::globalInstance()->start([this, currentFrame]() {
-            QString fileName = QUuid::createUuid().toString() + ".png";
-            QString filePath = QDir(m_tempPath).filePath(fileName);
-            if (currentFrame.save(filePath, "PNG")) {
-                QMetaObject::invokeMethod(this, "addImageToList", Qt::QueuedConnection,
-                                          Q_ARG(QString, filePath));
-            }
-        });
+    // Luôn lấy frame gốc từ decoder: ảnh hiển thị có thể đã bị thu nhỏ/chuyển đổi nhanh
+    if (!m_playerPanel->getVideoWidget()->getCurrentImage().isNull()) {
+        emit requestCapture(false);
     }
     this->setFocus();
 }
 
 void MainWindow::onCaptureAndExport()
 {
-    QImage currentFrame = m_playerPanel->getVideoWidget()->getCurrentImage();
-    if (!currentFrame.isNull()) {
-        onExportImage(currentFrame);
+    if (!m_playerPanel->getVideoWidget()->getCurrentImage().isNull()) {
+        emit requestCapture(true);
     }
     this->setFocus();
 }
 
+void MainWindow::onCaptureReady(const QImage &image, bool exportImage)
+{
+    if (exportImage) {
+        onExportImage(image);
+    } else {
+        addCapturedImage(image);
+    }
+}
+
+void MainWindow::addCapturedImage(const QImage &image)
+{
+    // Ảnh ở lại trong bộ nhớ; kho chỉ ghi ra đĩa khi cần nhường chỗ
+    const QString imageId = m_imageStore->insert(image);
+    if (!imageId.isEmpty()) addLibraryItem(imageId, image);
+}
+
 // === GIẢI PHÁP: Hoàn thiện chức năng Mute ===
 void MainWindow::onMuteClicked()
 {
@@ -368,9 +551,8 @@ void MainWindow::onMuteClicked()
 
 void MainWindow::onVolumeChanged(int volume)
 {
-    if (m_audioSink) {
-        m_audioSink->setVolume(volume / 100.0f);
-    }
+    emit requestAudioVolume(volume / 100.0f);
+    emit requestAudioMuted(volume == 0);
     // Chỉ lưu lại âm lượng khi nó > 0
     if (volume > 0) {
         m_lastVolume = volume / 100.0f;
@@ -396,7 +578,8 @@ void MainWindow::onTimelineMoved(int position)
         qint64 time = m_duration * (double)position / 1000.0;
         m_playerPanel->updateTimeLabelOnly(time, m_duration, m_frameRate);
         if (m_isScrubbing) {
-            emit requestSeek(time);
+            // Gọi trực tiếp (an toàn đa luồng): worker chỉ giữ mốc mới nhất
+            m_videoWorker->postSeek(time);
         }
     }
 }
@@ -404,7 +587,11 @@ void MainWindow::onTimelineMoved(int position)
 void MainWindow::onTimelineReleased()
 {
     m_isScrubbing = false;
-    if (m_isPlaying) {
+    updateVideoScalingMode();
+    emit requestScrubbing(false);
+    if (m_isPlayingReverse) {
+        emit requestPlayReverse(true);
+    } else if (m_isPlaying) {
         emit requestPlayPause(true);
     }
     this->setFocus();
@@ -417,15 +604,9 @@ void MainWindow::onExportImage(const QImage& image)
         QMessageBox::warning(this, "Lỗi", "Không có ảnh để xuất.");
         return;
     }
-    ExportPanel* exportPanel = m_sidePanel->getExportPanel();
-    QString savePath = exportPanel->getSavePath();
-    if (savePath.isEmpty()) {
-        savePath = QFileDialog::getExistingDirectory(this, "Chọn thư mục lưu");
-        if(savePath.isEmpty()) return;
-        exportPanel->setSavePath(savePath);
-    }
+    if (!ensureExportDirectory()) return;
     
-    QString format = exportPanel->getSelectedFormat().toLower();
+    QString format = m_sidePanel->getExportPanel()->getSelectedFormat().toLower();
     QString baseName = QFileInfo(m_currentVideoPath).baseName();
     if (baseName.isEmpty()) {
         baseName = "capture";
@@ -439,6 +620,60 @@ void MainWindow::onExportImage(const QImage& image)
     }
 }
 
+void MainWindow::onExportTiledComposite(std::shared_ptr<TiledCompositor> compositor)
+{
+    if (!compositor || compositor->size().isEmpty()) {
+        QMessageBox::warning(this, "Lỗi", "Không có ảnh để xuất.");
+        return;
+    }
+    if (!ensureExportDirectory()) return;
+
+    // Chỉ PNG và TIFF ghi được theo tile; định dạng khác được lưu thành TIFF
+    const QString selectedFormat = m_sidePanel->getExportPanel()->getSelectedFormat();
+    const bool png = selectedFormat.compare("PNG", Qt::CaseInsensitive) == 0;
+    const QString format = png ? "png" : "tiff";
+    QString baseName = QFileInfo(m_currentVideoPath).baseName();
+    if (baseName.isEmpty()) {
+        baseName = "capture";
+    }
+    const QString fullPath = generateUniqueFilename(baseName, format);
+
+    compositor->setPngCompression(m_pngCompression);
+    auto cancel = std::make_shared<std::atomic<bool>>(false);
+    auto *progress = new QProgressDialog("Đang ghi ảnh ghép lớn...", "Hủy", 0, 0, this);
+    progress->setWindowModality(Qt::WindowModal);
+    progress->setMinimumDuration(300);
+    connect(progress, &QProgressDialog::canceled, this, [cancel]() { *cancel = true; });
+
+    auto *watcher = new QFutureWatcher<bool>(this);
+    connect(watcher, &QFutureWatcher<bool>::finished, this, [this, watcher, progress, cancel, fullPath, png, selectedFormat]() {
+        // Không gọi close(): QProgressDialog phát canceled khi bị đóng
+        progress->hide();
+        progress->deleteLater();
+        watcher->deleteLater();
+        if (watcher->result()) {
+            QString message = "Đã lưu ảnh tại:\n" + fullPath;
+            if (!png && selectedFormat.compare("TIFF", Qt::CaseInsensitive) != 0) {
+                message += QString("\n\nẢnh ghép quá lớn để lưu dạng %1, đã lưu dạng TIFF.").arg(selectedFormat);
+            }
+            QMessageBox::information(this, "Thành công", message);
+        } else if (!*cancel) {
+            QMessageBox::critical(this, "Lỗi", "Không thể lưu ảnh.");
+        }
+    });
+    watcher->setFuture(QtConcurrent::run([compositor, fullPath, png, cancel, progress]() {
+        // progress còn sống đến khi tác vụ xong (bị xóa trong finished)
+        auto report = [progress](int done, int total) {
+            QMetaObject::invokeMethod(progress, [progress, done, total]() {
+                progress->setMaximum(total);
+                progress->setValue(done);
+            }, Qt::QueuedConnection);
+        };
+        return png ? compositor->writePng(fullPath, cancel.get(), report)
+                   : compositor->writeTiledTiff(fullPath, cancel.get(), report);
+    }));
+}
+
 void MainWindow::onAddImagesToLibrary()
 {
     QStringList filePaths = QFileDialog::getOpenFileNames(
@@ -466,12 +701,7 @@ void MainWindow::onImagesDroppedOnLibrary(const QList<QUrl> &urls)
 
 void MainWindow::cleanupAudio()
 {
-    if(m_audioSink) {
-        m_audioSink->stop();
-        delete m_audioSink;
-        m_audioSink = nullptr;
-        m_audioDevice = nullptr;
-    }
+    emit requestStopAudio();
 }
 
 QString MainWindow::generateUniqueFilename(const QString& baseName, const QString& extension)
@@ -486,6 +716,21 @@ QString MainWindow::generateUniqueFilename(const QString& baseName, const QStrin
     return fullPath;
 }
 
+bool MainWindow::ensureExportDirectory()
+{
+    ExportPanel* exportPanel = m_sidePanel->getExportPanel();
+    if (!exportPanel->getSavePath().isEmpty()) return true;
+    QString savePath = QFileDialog::getExistingDirectory(this, "Chọn thư mục lưu");
+    if (savePath.isEmpty()) return false;
+    exportPanel->setSavePath(savePath);
+    return true;
+}
+
+void MainWindow::updateVideoScalingMode()
+{
+    m_playerPanel->getVideoWidget()->setFastScaling(m_isPlaying || m_isScrubbing);
+}
+
 void MainWindow::ensureRightPanelVisible()
 {
     if (mainSplitter->widget(1)->width() == 0) {
@@ -493,18 +738,22 @@ void MainWindow::ensureRightPanelVisible()
     }
 }
 
-void MainWindow::addImageToList(const QString &imagePath)
+void MainWindow::addImageToList(const QString &imagePath, const QImage &decoded)
 {
-    ensureRightPanelVisible();
-    QImage image(imagePath);
+    // Giải mã một lần: vừa làm ảnh thu nhỏ vừa giữ trong kho cho ViewPanel/CropDialog
+    const QImage image = decoded.isNull() ? QImage(imagePath) : decoded;
     if (image.isNull()) return;
-    m_capturedFramePaths.append(imagePath);
-    
+    addLibraryItem(m_imageStore->insertFile(imagePath, image), image);
+}
+
+void MainWindow::addLibraryItem(const QString &imageId, const QImage &image)
+{
+    ensureRightPanelVisible();
     LibraryWidget* libraryWidget = m_sidePanel->getLibraryWidget();
     QPixmap thumbnailPixmap = QPixmap::fromImage(image.scaled(libraryWidget->iconSize(), Qt::KeepAspectRatio, Qt::SmoothTransformation));
     
     QListWidgetItem *item = new QListWidgetItem(QIcon(thumbnailPixmap), "");
-    item->setData(Qt::UserRole, imagePath); 
+    item->setData(Qt::UserRole, imageId); 
     item->setFlags(item->flags() | Qt::ItemIsUserCheckable);
     item->setCheckState(Qt::Unchecked);
     libraryWidget->addItem(item);
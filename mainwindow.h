@@ -1,4 +1,4 @@
-// mainwindow.h - Version 7.0 (Hoàn thiện Mute & DragDrop)
+// mainwindow.h - Version 7.1 (Nhận ảnh chụp loạt đã giải mã)
 #ifndef MAINWINDOW_H
 #define MAINWINDOW_H
 
@@ -10,13 +10,16 @@
 // --- Forward declarations ---
 class QSplitter;
 class QKeyEvent;
-class QAudioSink;
-class QIODevice;
 class QThread;
 class VideoWorker;
 class SidePanel; 
 class PlayerPanel; 
 class QListWidgetItem; 
+class ThumbnailGenerator;
+class AudioOutput;
+class EncodePipeline;
+class ImageStore;
+class TiledCompositor;
 
 class MainWindow : public QMainWindow
 {
@@ -28,11 +31,23 @@ public:
 
 signals:
     void requestOpenFile(const QString &filePath);
-    void requestSeek(qint64 timestamp);
+    void requestSeekToFrame(int frameNumber);
     void requestPlayPause(bool play);
+    void requestPlayReverse(bool play);
     void requestNextFrame();
     void requestPrevFrame();
+    void requestDecoderThreading(VideoProcessor::DecoderThreading mode, int threadCount);
+    void requestDecodeAheadLimits(int maxFrames, qint64 maxBytes);
+    void requestFrameCacheLimit(qint64 maxBytes);
+    void requestScrubbing(bool scrubbing);
+    void requestCapture(bool exportImage);
+    void requestCaptureQuality(VideoProcessor::ConversionQuality quality);
+    void requestBurstCapture(qint64 startUs, qint64 endUs, int stride, const QString &outputDir);
     void requestStop();
+    void requestStartAudio(int sampleRate, int channels);
+    void requestStopAudio();
+    void requestAudioVolume(float volume);
+    void requestAudioMuted(bool muted);
 
     void playerStateChanged(bool isVideoLoaded);
     void newFrameReady(const FrameData& frameData, qint64 duration, double frameRate, const AVRational& timeBase);
@@ -44,14 +59,17 @@ protected:
     void closeEvent(QCloseEvent *event) override;
 
 public slots:
-    void addImageToList(const QString &imagePath);
+    // decoded: ảnh đã có sẵn trong bộ nhớ (chụp loạt); rỗng thì giải mã từ imagePath
+    void addImageToList(const QString &imagePath, const QImage &decoded = QImage());
 
 private slots:
     void onFileOpened(bool success, VideoProcessor::AudioParams params, double frameRate, qint64 duration, AVRational timeBase);
     void onFrameReady(const FrameData &frameData);
+    void onCaptureReady(const QImage &image, bool exportImage);
 
     void onOpenFile();
     void onPlayPause();
+    void onPlayReverse();
     void onCapture();
     void onCaptureAndExport();
     void onMuteClicked(); // Đã được lập trình
@@ -61,6 +79,7 @@ private slots:
     void onTimelineReleased();
 
     void onExportImage(const QImage& image);
+    void onExportTiledComposite(std::shared_ptr<TiledCompositor> compositor);
     void onAddImagesToLibrary();
     void onImagesDroppedOnLibrary(const QList<QUrl> &urls);
 
@@ -75,29 +94,54 @@ private:
     
     void cleanupAudio();
     QString generateUniqueFilename(const QString& baseName, const QString& extension);
+    bool ensureExportDirectory(); // false nếu người dùng không chọn thư mục lưu
     void ensureRightPanelVisible();
+    void updateVideoScalingMode();
+    void addCapturedImage(const QImage &image);
+    void addLibraryItem(const QString &imageId, const QImage &image);
     
     // Layout & Modules
     QSplitter *mainSplitter;
     PlayerPanel *m_playerPanel;
     SidePanel *m_sidePanel; 
 
+    // Ảnh thu nhỏ cho thanh thời gian, trích ở nền
+    ThumbnailGenerator *m_thumbnailGenerator;
+
+    // Ghi ảnh chụp (chụp đơn và chụp loạt); dùng chung với VideoWorker
+    std::shared_ptr<EncodePipeline> m_encodePipeline;
+    // Ảnh của thư viện (đã giải mã, có ngân sách bộ nhớ); item thư viện giữ ID trong kho
+    std::shared_ptr<ImageStore> m_imageStore;
+
     // Worker Thread
     std::unique_ptr<VideoWorker> m_videoWorker;
     std::unique_ptr<QThread> m_videoThread;
     
-    // Audio
-    QAudioSink *m_audioSink = nullptr;
-    QIODevice *m_audioDevice = nullptr;
+    // Audio: phát trên luồng riêng, kéo PCM thẳng từ bộ đệm của VideoWorker
+    std::unique_ptr<AudioOutput> m_audioOutput;
+    std::unique_ptr<QThread> m_audioThread;
     float m_lastVolume = 1.0f; // Lưu lại âm lượng trước khi Mute
 
     // Data & State
     bool m_isPlaying = false;
+    bool m_isPlayingReverse = false;
     bool m_isScrubbing = false;
-    QList<QString> m_capturedFramePaths; 
     QString m_currentVideoPath;
     QString m_tempPath;
     QString m_lastUsedDir;
+    VideoProcessor::DecoderThreading m_decoderThreading = VideoProcessor::ThreadingAuto;
+    int m_decoderThreadCount = 0;
+    int m_decodeAheadFrames = 8;
+    int m_decodeAheadMemoryMB = 256;
+    int m_frameCacheMemoryMB = 256;
+    VideoProcessor::ConversionQuality m_captureQuality = VideoProcessor::ConversionHighQuality;
+    int m_encodeWorkers = 0; // 0 = tự chọn theo số lõi
+    int m_encodeQueueImages = 16;
+    int m_encodeQueueMemoryMB = 512;
+    int m_captureFormat = 0; // EncodePipeline::Format
+    int m_pngCompression = 1;
+    int m_libraryMemoryMB = 512;
+    int m_tiledExportMegapixels = 64;
 
     // Video Info
     double m_frameRate = 0.0;
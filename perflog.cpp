@@ -0,0 +1,4 @@
+// perflog.cpp - Version 1.0
+#include "perflog.h"
+
+Q_LOGGING_CATEGORY(lcPerf, "framecapture.perf", QtWarningMsg)
@@ -0,0 +1,11 @@
+// perflog.h - Version 1.0
+// Category log cho số liệu đo hiệu năng (tốc độ giải mã, thời gian chụp/xuất, bộ nhớ...).
+// Tắt mặc định; bật bằng QT_LOGGING_RULES="framecapture.perf.debug=true".
+#ifndef PERFLOG_H
+#define PERFLOG_H
+
+#include <QLoggingCategory>
+
+Q_DECLARE_LOGGING_CATEGORY(lcPerf)
+
+#endif // PERFLOG_H
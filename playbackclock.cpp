@@ -0,0 +1,66 @@
+// playbackclock.cpp - Version 1.0
+#include "playbackclock.h"
+#include <QMutexLocker>
+
+namespace {
+// Lệch hơn mức này thì coi vị trí âm thanh là dữ liệu cũ, không neo theo
+const qint64 kMaxAudioCorrectionUs = 500 * 1000;
+// Không nhận được vị trí âm thanh trong khoảng này thì đồng hồ monotonic tự chạy
+const qint64 kAudioMasterTimeoutNs = 500ll * 1000 * 1000;
+}
+
+PlaybackClock::PlaybackClock()
+{
+    m_timer.start();
+}
+
+void PlaybackClock::start(qint64 timeUs)
+{
+    QMutexLocker locker(&m_mutex);
+    m_anchorUs = timeUs;
+    m_anchorNs = m_timer.nsecsElapsed();
+    m_lastAudioUpdateNs = -1;
+    m_running = true;
+}
+
+void PlaybackClock::pause()
+{
+    QMutexLocker locker(&m_mutex);
+    m_anchorUs = nowLocked();
+    m_anchorNs = m_timer.nsecsElapsed();
+    m_running = false;
+}
+
+void PlaybackClock::setAudioTime(qint64 timeUs)
+{
+    QMutexLocker locker(&m_mutex);
+    if (!m_running) return;
+    if (qAbs(timeUs - nowLocked()) > kMaxAudioCorrectionUs) return;
+    m_anchorUs = timeUs;
+    m_anchorNs = m_timer.nsecsElapsed();
+    m_lastAudioUpdateNs = m_anchorNs;
+}
+
+qint64 PlaybackClock::now() const
+{
+    QMutexLocker locker(&m_mutex);
+    return nowLocked();
+}
+
+bool PlaybackClock::isRunning() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_running;
+}
+
+bool PlaybackClock::isAudioMaster() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_lastAudioUpdateNs >= 0 && m_timer.nsecsElapsed() - m_lastAudioUpdateNs < kAudioMasterTimeoutNs;
+}
+
+qint64 PlaybackClock::nowLocked() const
+{
+    if (!m_running) return m_anchorUs;
+    return m_anchorUs + (m_timer.nsecsElapsed() - m_anchorNs) / 1000;
+}
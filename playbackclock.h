@@ -0,0 +1,39 @@
+// playbackclock.h - Version 1.0
+// Đồng hồ chủ cho việc trình chiếu frame theo pts. Chạy bằng đồng hồ monotonic, và khi có âm thanh
+// thì được neo lại theo vị trí âm thanh đang thực sự phát (âm thanh là đồng hồ chủ).
+// An toàn đa luồng: VideoWorker đọc, luồng quản lý thiết bị âm thanh cập nhật.
+#ifndef PLAYBACKCLOCK_H
+#define PLAYBACKCLOCK_H
+
+#include <QElapsedTimer>
+#include <QMutex>
+
+class PlaybackClock
+{
+public:
+    PlaybackClock();
+
+    // Bắt đầu/tiếp tục chạy từ timeUs (khi bắt đầu phát hoặc sau khi tua)
+    void start(qint64 timeUs);
+    void pause();
+    // Vị trí (micro giây) của mẫu âm thanh đang phát ra loa. Bị bỏ qua nếu lệch quá xa
+    // đồng hồ hiện tại (vd. âm thanh cũ còn trong bộ đệm ngay sau khi tua).
+    void setAudioTime(qint64 timeUs);
+
+    qint64 now() const;
+    bool isRunning() const;
+    // Âm thanh có đang điều khiển đồng hồ không (vừa được cập nhật gần đây)
+    bool isAudioMaster() const;
+
+private:
+    qint64 nowLocked() const;
+
+    mutable QMutex m_mutex;
+    QElapsedTimer m_timer;
+    qint64 m_anchorUs = 0;
+    qint64 m_anchorNs = 0;
+    qint64 m_lastAudioUpdateNs = -1;
+    bool m_running = false;
+};
+
+#endif // PLAYBACKCLOCK_H
@@ -1,5 +1,16 @@
-// playerpanel.cpp - Version 1.2 (Hoàn thiện Mute)
+// playerpanel.cpp - Version 1.8 (Trạng thái hàng đợi ghi ảnh)
 // Change-log:
+// - Version 1.8: Nhãn số ảnh đang chờ ghi ra đĩa.
+// - Version 1.7: Điểm vào/ra (I/O) trên thanh thời gian, bước lấy frame và nút chụp loạt có tiến độ.
+// - Version 1.6: Nhãn nhỏ hiện độ lệch A/V và số frame bị bỏ khi phát.
+// - Version 1.5:
+//   - Dải ảnh thu nhỏ dưới thanh thời gian và ảnh xem trước khi rê chuột (ảnh dựng sẵn ở nền).
+//   - eventFilter không còn nuốt MouseMove của thanh thời gian (để kéo vẫn hoạt động).
+// - Version 1.4:
+//   - Thêm nút phát ngược (Shift+Space).
+// - Version 1.3:
+//   - Số frame lấy từ FrameData (theo chỉ mục pts) thay vì tính từ micro giây * fps.
+//   - Nhấp đúp vào nhãn thời gian để nhảy tới một frame cụ thể.
 // - Version 1.2:
 //   - Thêm slot setVolume() và hàm isMuted().
 // - Version 1.1: Thêm Time Label Update.
@@ -7,6 +18,7 @@
 #include "playerpanel.h"
 #include "videowidget.h"
 #include "helpers.h"
+#include "thumbnailstrip.h"
 
 #include <QVBoxLayout>
 #include <QHBoxLayout>
@@ -14,11 +26,17 @@
 #include <QPushButton>
 #include <QSlider>
 #include <QLabel>
+#include <QSpinBox>
 #include <QAction>
 #include <QStyle>
 #include <QKeyEvent>
 #include <QToolTip>
 #include <QMouseEvent>
+#include <QInputDialog>
+#include <QIcon>
+#include <QTransform>
+#include <QPainter>
+#include <climits>
 
 PlayerPanel::PlayerPanel(QWidget *parent) : QWidget(parent)
 {
@@ -42,6 +60,21 @@ void PlayerPanel::setVolume(int volume)
     m_volumeSlider->setValue(volume);
 }
 
+void PlayerPanel::resetThumbnails(qint64 durationUs)
+{
+    m_thumbnailStrip->reset(durationUs);
+    m_hoverPreview->hide();
+    // File mới: khoảng vào/ra cũ không còn ý nghĩa
+    m_inPointUs = -1;
+    m_outPointUs = -1;
+    m_thumbnailStrip->setRange(-1, -1);
+}
+
+void PlayerPanel::addThumbnail(const Thumbnail &thumbnail)
+{
+    m_thumbnailStrip->addThumbnail(thumbnail);
+}
+
 void PlayerPanel::setupUi()
 {
     QGroupBox *playerBox = new QGroupBox("Trình Phát", this);
@@ -61,15 +94,41 @@ void PlayerPanel::setupUi()
     m_timelineSlider->setMouseTracking(true);
     m_timelineSlider->installEventFilter(this);
 
+    m_thumbnailStrip = new ThumbnailStrip();
+    m_hoverPreview = new QLabel(this, Qt::ToolTip | Qt::FramelessWindowHint);
+    m_hoverPreview->setStyleSheet("border: 1px solid #555; background-color: black;");
+    m_hoverPreview->hide();
+
     m_timeLabel = new QLabel("00:00.000 / 00:00.000");
-    timelineLayout->addWidget(m_timelineSlider);
-    timelineLayout->addWidget(m_timeLabel);
+    m_timeLabel->setToolTip("Nhấp đúp để nhảy tới frame");
+    m_timeLabel->installEventFilter(this);
+    QVBoxLayout *sliderLayout = new QVBoxLayout();
+    sliderLayout->setSpacing(2);
+    sliderLayout->addWidget(m_timelineSlider);
+    sliderLayout->addWidget(m_thumbnailStrip);
+    timelineLayout->addLayout(sliderLayout);
+    m_playbackStatsLabel = new QLabel();
+    m_playbackStatsLabel->setStyleSheet("color: gray; font-size: 10px;");
+    m_playbackStatsLabel->setToolTip("Độ lệch hình so với âm thanh (hoặc đồng hồ) và số frame bị bỏ vì trễ");
+    QVBoxLayout *timeLabelLayout = new QVBoxLayout();
+    timeLabelLayout->setSpacing(0);
+    timeLabelLayout->addWidget(m_timeLabel);
+    timeLabelLayout->addWidget(m_playbackStatsLabel);
+    m_encodeStatusLabel = new QLabel();
+    m_encodeStatusLabel->setStyleSheet("color: gray; font-size: 10px;");
+    m_encodeStatusLabel->setToolTip("Số ảnh chụp đang chờ ghi ra đĩa");
+    m_encodeStatusLabel->hide();
+    timeLabelLayout->addWidget(m_encodeStatusLabel);
+    timelineLayout->addLayout(timeLabelLayout);
     leftLayout->addLayout(timelineLayout);
 
     QHBoxLayout *controlLayout = new QHBoxLayout();
     m_prevFrameButton = new QPushButton();
     m_prevFrameButton->setIcon(style()->standardIcon(QStyle::SP_MediaSeekBackward));
     m_prevFrameButton->setToolTip("Frame trước (Phím ←)");
+    m_reversePlayButton = new QPushButton();
+    m_reversePlayButton->setIcon(reversePlayIcon());
+    m_reversePlayButton->setToolTip("Phát ngược/Dừng (Phím Shift+Space)");
     m_playPauseButton = new QPushButton();
     m_playPauseButton->setIcon(style()->standardIcon(QStyle::SP_MediaPlay));
     m_playPauseButton->setToolTip("Phát/Dừng (Phím Space)");
@@ -79,6 +138,7 @@ void PlayerPanel::setupUi()
     
     QSize buttonIconSize(36, 36);
     m_prevFrameButton->setIconSize(buttonIconSize);
+    m_reversePlayButton->setIconSize(buttonIconSize);
     m_playPauseButton->setIconSize(buttonIconSize);
     m_nextFrameButton->setIconSize(buttonIconSize);
 
@@ -114,6 +174,22 @@ void PlayerPanel::setupUi()
     m_toggleRightPanelButton->setCheckable(true);
     m_toggleRightPanelButton->setChecked(false);
 
+    m_markInButton = new QPushButton("[");
+    m_markInButton->setToolTip("Đặt điểm vào tại frame hiện tại (Phím I)");
+    m_markInButton->setMaximumWidth(28);
+    m_markOutButton = new QPushButton("]");
+    m_markOutButton->setToolTip("Đặt điểm ra tại frame hiện tại (Phím O)");
+    m_markOutButton->setMaximumWidth(28);
+    m_burstStrideSpin = new QSpinBox();
+    m_burstStrideSpin->setRange(1, 1000);
+    m_burstStrideSpin->setPrefix("mỗi ");
+    m_burstStrideSpin->setSuffix(" frame");
+    m_burstStrideSpin->setToolTip("Khoảng cách giữa hai frame được chụp trong chế độ chụp loạt");
+    m_burstButton = new QPushButton("Chụp loạt");
+    m_burstButton->setToolTip("Chụp các frame trong khoảng vào/ra vào thư viện");
+    m_burstButton->setStyleSheet("background-color: #e67e22; color: white; border: none; padding: 5px; border-radius: 3px;");
+
+    controlLayout->addWidget(m_reversePlayButton);
     controlLayout->addWidget(m_prevFrameButton);
     controlLayout->addWidget(m_playPauseButton);
     controlLayout->addWidget(m_nextFrameButton);
@@ -121,6 +197,10 @@ void PlayerPanel::setupUi()
     controlLayout->addWidget(m_muteButton);
     controlLayout->addWidget(m_volumeSlider);
     controlLayout->addSpacing(20);
+    controlLayout->addWidget(m_markInButton);
+    controlLayout->addWidget(m_markOutButton);
+    controlLayout->addWidget(m_burstStrideSpin);
+    controlLayout->addWidget(m_burstButton);
     controlLayout->addWidget(m_captureAndExportButton);
     controlLayout->addWidget(m_captureButton);
     controlLayout->addWidget(m_openButton);
@@ -134,6 +214,7 @@ void PlayerPanel::setupUi()
     connect(m_captureButton, &QPushButton::clicked, this, &PlayerPanel::captureClicked);
     connect(m_captureAndExportButton, &QPushButton::clicked, this, &PlayerPanel::captureAndExportClicked);
     connect(m_playPauseButton, &QPushButton::clicked, this, &PlayerPanel::playPauseClicked);
+    connect(m_reversePlayButton, &QPushButton::clicked, this, &PlayerPanel::reversePlayClicked);
     connect(m_nextFrameButton, &QPushButton::clicked, this, &PlayerPanel::nextFrameClicked);
     connect(m_prevFrameButton, &QPushButton::clicked, this, &PlayerPanel::prevFrameClicked);
     connect(m_timelineSlider, &QSlider::sliderPressed, this, &PlayerPanel::timelinePressed);
@@ -142,6 +223,21 @@ void PlayerPanel::setupUi()
     connect(m_muteButton, &QPushButton::clicked, this, &PlayerPanel::muteClicked);
     connect(m_volumeSlider, &QSlider::valueChanged, this, &PlayerPanel::volumeChanged);
     connect(m_toggleRightPanelButton, &QPushButton::clicked, this, &PlayerPanel::toggleRightPanelClicked);
+    connect(m_markInButton, &QPushButton::clicked, this, &PlayerPanel::markIn);
+    connect(m_markOutButton, &QPushButton::clicked, this, &PlayerPanel::markOut);
+    connect(m_burstButton, &QPushButton::clicked, this, [this]() {
+        if (m_burstRunning) {
+            emit burstCancelRequested();
+            return;
+        }
+        // Chưa đặt điểm nào thì lấy từ đầu / tới cuối video
+        const qint64 inUs = m_inPointUs >= 0 ? m_inPointUs : 0;
+        const qint64 outUs = m_outPointUs >= 0 ? m_outPointUs : m_duration;
+        if (outUs < inUs) return;
+        m_burstRunning = true;
+        m_burstButton->setText("Dừng chụp loạt");
+        emit burstCaptureRequested(inUs, outUs, m_burstStrideSpin->value());
+    });
 
     connect(m_volumeSlider, &QSlider::valueChanged, this, [this](int volume){
         bool isMutedNow = (volume == 0);
@@ -154,12 +250,16 @@ void PlayerPanel::setupUi()
 void PlayerPanel::updatePlayerState(bool isVideoLoaded)
 {
     m_playPauseButton->setEnabled(isVideoLoaded);
+    m_reversePlayButton->setEnabled(isVideoLoaded);
     m_nextFrameButton->setEnabled(isVideoLoaded);
     m_prevFrameButton->setEnabled(isVideoLoaded);
     m_timelineSlider->setEnabled(isVideoLoaded);
     m_captureButton->setEnabled(isVideoLoaded);
     m_captureAndExportButton->setEnabled(isVideoLoaded);
     m_captureExportAction->setEnabled(isVideoLoaded);
+    m_markInButton->setEnabled(isVideoLoaded);
+    m_markOutButton->setEnabled(isVideoLoaded);
+    m_burstButton->setEnabled(isVideoLoaded);
 }
 
 void PlayerPanel::updateUIWithFrame(const FrameData& frameData, qint64 duration, double frameRate, const AVRational& timeBase)
@@ -170,8 +270,9 @@ void PlayerPanel::updateUIWithFrame(const FrameData& frameData, qint64 duration,
 
         m_duration = duration;
         int64_t currentTimeUs = frameData.pts * 1000000 * timeBase.num / timeBase.den;
+        m_currentTimeUs = currentTimeUs;
         
-        updateTimeLabelOnly(currentTimeUs, duration, frameRate);
+        updateTimeLabelOnly(currentTimeUs, duration, frameRate, frameData.frameNumber);
 
         m_timelineSlider->blockSignals(true);
         if (duration > 0) {
@@ -181,24 +282,91 @@ void PlayerPanel::updateUIWithFrame(const FrameData& frameData, qint64 duration,
     }
 }
 
-void PlayerPanel::updateTimeLabelOnly(qint64 currentTimeUs, qint64 totalTimeUs, double frameRate)
+void PlayerPanel::updateTimeLabelOnly(qint64 currentTimeUs, qint64 totalTimeUs, double frameRate, int frameNumber)
 {
     QString timeStr = formatTime(currentTimeUs);
     QString durationStr = formatTime(totalTimeUs);
-    if (frameRate > 0) {
-        long long currentFrame = (currentTimeUs / 1000000.0) * frameRate;
-        long long totalFrames = (totalTimeUs / 1000000.0) * frameRate;
+    if (frameRate > 0 || frameNumber >= 0) {
+        long long currentFrame = frameNumber >= 0 ? frameNumber : (long long)((currentTimeUs / 1000000.0) * frameRate);
+        long long totalFrames = m_totalFrames > 0 ? m_totalFrames : (long long)((totalTimeUs / 1000000.0) * frameRate);
+        if (frameNumber >= 0) m_currentFrame = frameNumber;
         m_timeLabel->setText(QString("%1 (Frame %2) / %3 (Frame %4)").arg(timeStr).arg(currentFrame).arg(durationStr).arg(totalFrames));
     } else {
         m_timeLabel->setText(QString("%1 / %2").arg(timeStr).arg(durationStr));
     }
 }
 
+void PlayerPanel::setTotalFrames(int frameCount)
+{
+    m_totalFrames = frameCount;
+}
+
+void PlayerPanel::setPlaybackStats(qint64 avOffsetUs, quint64 droppedFrames)
+{
+    m_playbackStatsLabel->setText(QString("A/V %1%2 ms · bỏ %3 frame")
+                                      .arg(avOffsetUs >= 0 ? "+" : "")
+                                      .arg(avOffsetUs / 1000)
+                                      .arg(droppedFrames));
+}
+
+void PlayerPanel::markIn()
+{
+    m_inPointUs = m_currentTimeUs;
+    if (m_outPointUs >= 0 && m_outPointUs < m_inPointUs) m_outPointUs = -1;
+    m_thumbnailStrip->setRange(m_inPointUs, m_outPointUs);
+}
+
+void PlayerPanel::markOut()
+{
+    m_outPointUs = m_currentTimeUs;
+    if (m_inPointUs > m_outPointUs) m_inPointUs = -1;
+    m_thumbnailStrip->setRange(m_inPointUs, m_outPointUs);
+}
+
+void PlayerPanel::setBurstProgress(int saved, int total)
+{
+    if (!m_burstRunning) return;
+    m_burstButton->setText(QString("Dừng (%1/%2)").arg(saved).arg(qMax(saved, total)));
+}
+
+void PlayerPanel::setBurstFinished(int saved, double framesPerSecond)
+{
+    m_burstRunning = false;
+    m_burstButton->setText("Chụp loạt");
+    m_burstButton->setToolTip(QString("Chụp các frame trong khoảng vào/ra vào thư viện\nLần trước: %1 ảnh, %2 ảnh/giây")
+                                  .arg(saved).arg(framesPerSecond, 0, 'f', 1));
+}
+
+void PlayerPanel::setEncodeQueueStatus(int pending, int maxJobs)
+{
+    if (pending <= 0) {
+        m_encodeStatusLabel->hide();
+        return;
+    }
+    // Đổi màu khi hàng đợi đã đầy: lần chụp kế tiếp sẽ bị từ chối
+    m_encodeStatusLabel->setStyleSheet(pending >= maxJobs ? "color: #e67e22; font-size: 10px;"
+                                                          : "color: gray; font-size: 10px;");
+    m_encodeStatusLabel->setText(QString("Đang ghi %1/%2 ảnh").arg(pending).arg(maxJobs));
+    m_encodeStatusLabel->show();
+}
+
 void PlayerPanel::setPlayPauseButtonIcon(bool isPlaying)
 {
     m_playPauseButton->setIcon(style()->standardIcon(isPlaying ? QStyle::SP_MediaPause : QStyle::SP_MediaPlay));
 }
 
+void PlayerPanel::setReversePlayButtonIcon(bool isPlaying)
+{
+    m_reversePlayButton->setIcon(isPlaying ? style()->standardIcon(QStyle::SP_MediaPause) : reversePlayIcon());
+}
+
+QIcon PlayerPanel::reversePlayIcon() const
+{
+    // Qt không có sẵn biểu tượng phát ngược: lật ngang biểu tượng phát
+    QPixmap pixmap = style()->standardIcon(QStyle::SP_MediaPlay).pixmap(64, 64);
+    return QIcon(pixmap.transformed(QTransform().scale(-1, 1)));
+}
+
 bool PlayerPanel::eventFilter(QObject *watched, QEvent *event)
 {
     if (watched == m_timelineSlider && event->type() == QEvent::MouseMove) {
@@ -210,14 +378,53 @@ bool PlayerPanel::eventFilter(QObject *watched, QEvent *event)
             value = qBound(m_timelineSlider->minimum(), value, m_timelineSlider->maximum());
 
             qint64 hoverTimeUs = m_duration * (double)value / 1000.0;
-            QString timeStr = formatTime(hoverTimeUs);
-            QToolTip::showText(mouseEvent->globalPos(), timeStr, m_timelineSlider);
+            showHoverPreview(hoverTimeUs, mouseEvent->globalPosition().toPoint());
         }
+        return false;
+    }
+    if (watched == m_timelineSlider && event->type() == QEvent::Leave) {
+        m_hoverPreview->hide();
+    }
+    if (watched == m_timeLabel && event->type() == QEvent::MouseButtonDblClick && m_timelineSlider->isEnabled()) {
+        int maxFrame = m_totalFrames > 0 ? m_totalFrames - 1 : INT_MAX;
+        bool ok = false;
+        int frameNumber = QInputDialog::getInt(this, "Nhảy tới frame", "Số frame:",
+                                               qMax(0, m_currentFrame), 0, maxFrame, 1, &ok);
+        if (ok) emit frameSeekRequested(frameNumber);
         return true;
     }
     return QWidget::eventFilter(watched, event);
 }
 
+void PlayerPanel::showHoverPreview(qint64 timeUs, const QPoint &globalPos)
+{
+    QString timeStr = formatTime(timeUs);
+    const Thumbnail *thumbnail = m_thumbnailStrip->thumbnailNear(timeUs);
+    if (!thumbnail) {
+        // Ảnh thu nhỏ chưa sẵn sàng: chỉ hiện thời gian như trước
+        QToolTip::showText(globalPos, timeStr, m_timelineSlider);
+        return;
+    }
+    QToolTip::hideText();
+
+    // Ảnh đã giải mã sẵn ở nền; ở đây chỉ ghép ảnh với dòng thời gian
+    const QImage &image = thumbnail->image;
+    const int captionHeight = fontMetrics().height() + 4;
+    QPixmap preview(image.width(), image.height() + captionHeight);
+    preview.fill(Qt::black);
+    QPainter painter(&preview);
+    painter.drawImage(0, 0, image);
+    painter.setPen(Qt::white);
+    painter.drawText(QRect(0, image.height(), image.width(), captionHeight), Qt::AlignCenter, timeStr);
+    painter.end();
+
+    m_hoverPreview->setPixmap(preview);
+    m_hoverPreview->adjustSize();
+    QPoint sliderTop = m_timelineSlider->mapToGlobal(QPoint(0, 0));
+    m_hoverPreview->move(globalPos.x() - m_hoverPreview->width() / 2, sliderTop.y() - m_hoverPreview->height() - 4);
+    m_hoverPreview->show();
+}
+
 QString PlayerPanel::formatTime(int64_t timeUs)
 {
     int totalMilliseconds = timeUs / 1000;
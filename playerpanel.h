@@ -1,18 +1,21 @@
-// playerpanel.h - Version 1.2 (Hoàn thiện Mute)
+// playerpanel.h - Version 1.8 (Trạng thái hàng đợi ghi ảnh)
 #ifndef PLAYERPANEL_H
 #define PLAYERPANEL_H
 
 #include <QWidget>
 #include "videoprocessor.h" 
+#include "thumbnailgenerator.h"
 
 class VideoWidget;
 class QPushButton;
 class QSlider;
 class QLabel;
+class QSpinBox;
 class QAction;
 class QGroupBox;
 class QKeyEvent;
 class TitleEventFilter;
+class ThumbnailStrip;
 
 class PlayerPanel : public QWidget
 {
@@ -26,6 +29,7 @@ public:
 signals:
     void openFileClicked();
     void playPauseClicked();
+    void reversePlayClicked();
     void nextFrameClicked();
     void prevFrameClicked();
     void captureClicked();
@@ -37,17 +41,36 @@ signals:
     void muteClicked();
     void volumeChanged(int volume);
     void seekRequested(qint64 timestamp);
+    void frameSeekRequested(int frameNumber);
+    // Chụp loạt khoảng [inUs, outUs], mỗi stride frame lấy một ảnh
+    void burstCaptureRequested(qint64 inUs, qint64 outUs, int stride);
+    void burstCancelRequested();
 
 public slots:
     void updatePlayerState(bool isVideoLoaded);
     void updateUIWithFrame(const FrameData& frameData, qint64 duration, double frameRate, const AVRational& timeBase);
     void setPlayPauseButtonIcon(bool isPlaying);
-    void updateTimeLabelOnly(qint64 currentTimeUs, qint64 totalTimeUs, double frameRate);
+    void setReversePlayButtonIcon(bool isPlaying);
+    // frameNumber < 0: ước lượng từ thời gian và fps (vd. khi đang kéo thanh thời gian)
+    void updateTimeLabelOnly(qint64 currentTimeUs, qint64 totalTimeUs, double frameRate, int frameNumber = -1);
+    void setTotalFrames(int frameCount);
     bool eventFilter(QObject *watched, QEvent *event) override;
     void setVolume(int volume); // Thêm slot để điều khiển slider từ bên ngoài
+    void resetThumbnails(qint64 durationUs);
+    void addThumbnail(const Thumbnail &thumbnail);
+    void setPlaybackStats(qint64 avOffsetUs, quint64 droppedFrames);
+    // Đặt điểm vào/ra tại frame đang hiển thị (phím I / O)
+    void markIn();
+    void markOut();
+    void setBurstProgress(int saved, int total);
+    void setBurstFinished(int saved, double framesPerSecond);
+    // Số ảnh chụp đang chờ ghi ra đĩa; ẩn khi hàng đợi rỗng
+    void setEncodeQueueStatus(int pending, int maxJobs);
 
 private:
     QString formatTime(int64_t timeUs);
+    QIcon reversePlayIcon() const;
+    void showHoverPreview(qint64 timeUs, const QPoint &globalPos);
     void setupUi();
 
     // UI Components
@@ -55,19 +78,34 @@ private:
     VideoWidget *m_videoWidget;
     QPushButton *m_openButton;
     QPushButton *m_playPauseButton;
+    QPushButton *m_reversePlayButton;
     QPushButton *m_nextFrameButton;
     QPushButton *m_prevFrameButton;
     QPushButton *m_captureButton;
     QPushButton *m_captureAndExportButton;
     QPushButton *m_toggleRightPanelButton;
+    QPushButton *m_markInButton;
+    QPushButton *m_markOutButton;
+    QPushButton *m_burstButton;
+    QSpinBox *m_burstStrideSpin;
     QAction *m_captureExportAction;
     QSlider *m_timelineSlider;
+    ThumbnailStrip *m_thumbnailStrip;
+    QLabel *m_hoverPreview; // Cửa sổ nổi hiện ảnh thu nhỏ khi rê chuột trên thanh thời gian
     QLabel *m_timeLabel;
+    QLabel *m_playbackStatsLabel;
+    QLabel *m_encodeStatusLabel;
     QPushButton *m_muteButton;
     QSlider *m_volumeSlider;
 
     // Data
     qint64 m_duration = 0;
+    int m_totalFrames = 0;
+    int m_currentFrame = -1;
+    qint64 m_currentTimeUs = 0;
+    qint64 m_inPointUs = -1;
+    qint64 m_outPointUs = -1;
+    bool m_burstRunning = false;
 };
 
 #endif // PLAYERPANEL_H
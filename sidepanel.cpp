@@ -1,5 +1,20 @@
-// sidepanel.cpp - Version 2.8 (Thêm phím Delete)
+// sidepanel.cpp - Version 3.3 (Chặn dựng ảnh ghép chồng nhau)
 // Change-log:
+// - Version 3.3:
+//   - Bấm xuất/cắt khi ảnh ghép đang dựng bị bỏ qua; trước đây lần dựng thứ hai làm cả hai kết nối
+//     SingleShot cùng nhận một kết quả (chạy onDone hai lần, xuất ra hai file).
+// - Version 3.2:
+//   - Ảnh ghép vượt ngưỡng điểm ảnh không được dựng cả ảnh khi xuất mà chuyển cho MainWindow ghi theo tile.
+// - Version 3.1:
+//   - Xuất và cắt ảnh ghép chờ ViewPanel dựng ảnh độ phân giải gốc trên luồng nền, có hộp thoại
+//     tiến độ và nút hủy, thay vì chặn giao diện trong getCompositedImage.
+// - Version 3.0:
+//   - onLibraryItemsChanged so danh sách ID đang đánh dấu với ảnh đang có trong ViewPanel và chỉ
+//     thêm/bớt đúng các ảnh thay đổi; đổi biểu tượng item (sau khi cắt) không còn dựng lại ảnh ghép.
+// - Version 2.9:
+//   - Item thư viện giữ ID ảnh trong ImageStore thay vì đường dẫn PNG; xem, cắt, xuất nhanh và ảnh ghép
+//     lấy ảnh đã giải mã từ kho thay vì giải mã lại file mỗi lần đổi dấu chọn.
+//   - Ảnh đã cắt được thay trực tiếp trong kho, không ghi lại PNG.
 // - Version 2.8:
 //   - Thêm logic xử lý xóa ảnh bằng phím Delete.
 // - Version 2.7: Cải tiến logic toàn diện.
@@ -12,6 +27,7 @@
 #include "librarywidget.h"
 #include "cropdialog.h"
 #include "imageviewerdialog.h" 
+#include "imagestore.h"
 
 #include <QVBoxLayout>
 #include <QHBoxLayout>
@@ -19,8 +35,9 @@
 #include <QPushButton>
 #include <QLineEdit>
 #include <QMessageBox>
-#include <QThreadPool>
+#include <QProgressDialog>
 #include <QListWidget>
+#include <QSet>
 
 SidePanel::SidePanel(QWidget *parent) : QWidget(parent)
 {
@@ -122,49 +139,102 @@ void SidePanel::onDeleteSelection()
         QMessageBox::Yes | QMessageBox::No);
 
     if (ret == QMessageBox::Yes) {
-        for (QListWidgetItem* item : itemsToDelete) {
-            QString filePath = item->data(Qt::UserRole).toString();
-            emit fileDeleted(filePath); 
-            delete lw->takeItem(lw->row(item));
-        }
-        onLibraryItemsChanged(nullptr);
+        deleteItems(itemsToDelete);
     }
 }
 
+void SidePanel::setImageStore(std::shared_ptr<ImageStore> store)
+{
+    m_imageStore = std::move(store);
+}
+
+void SidePanel::setTiledExportThreshold(qint64 pixels)
+{
+    m_tiledExportThreshold = qMax<qint64>(0, pixels);
+}
+
+void SidePanel::clearLibrary()
+{
+    m_libraryPanel->getLibraryWidget()->clear();
+    if (m_imageStore) m_imageStore->clear();
+    m_viewImageIds.clear();
+    m_viewPanel->setImages({});
+}
+
+QImage SidePanel::imageForItem(QListWidgetItem* item) const
+{
+    if (!item || !m_imageStore) return QImage();
+    return m_imageStore->image(item->data(Qt::UserRole).toString());
+}
+
+void SidePanel::deleteItems(const QList<QListWidgetItem*> &items)
+{
+    LibraryWidget* lw = m_libraryPanel->getLibraryWidget();
+    for (QListWidgetItem* item : items) {
+        if (m_imageStore) m_imageStore->remove(item->data(Qt::UserRole).toString());
+        delete lw->takeItem(lw->row(item));
+    }
+    onLibraryItemsChanged(nullptr);
+}
+
 // ... (Các hàm còn lại không thay đổi) ...
 void SidePanel::onItemDoubleClicked(QListWidgetItem* item)
 {
-    QString filePath = item->data(Qt::UserRole).toString();
-    QImage image(filePath);
+    QImage image = imageForItem(item);
     if (!image.isNull()) {
         ImageViewerDialog dialog(image, this);
         dialog.exec();
     }
 }
 
+void SidePanel::renderFullComposite(std::function<void(const QImage&)> onDone)
+{
+    if (m_fullRenderInFlight) return;
+    m_fullRenderInFlight = true;
+    auto *progress = new QProgressDialog("Đang dựng ảnh ghép độ phân giải gốc...", "Hủy", 0, 0, this);
+    progress->setWindowModality(Qt::WindowModal);
+    progress->setMinimumDuration(300);
+    connect(m_viewPanel, &ViewPanel::fullRenderProgress, progress, [progress](int done, int total) {
+        progress->setMaximum(total);
+        progress->setValue(done);
+    });
+    connect(progress, &QProgressDialog::canceled, m_viewPanel, &ViewPanel::cancelFullRender);
+    connect(m_viewPanel, &ViewPanel::fullRenderFinished, this, [this, progress, onDone](const QImage &image) {
+        m_fullRenderInFlight = false;
+        // Không gọi close(): QProgressDialog phát canceled khi bị đóng
+        progress->hide();
+        progress->deleteLater();
+        onDone(image);
+    }, Qt::SingleShotConnection);
+    m_viewPanel->startFullRender();
+}
+
 void SidePanel::onViewPanelCrop()
 {
-    QImage imageToCrop = m_viewPanel->getCompositedImage();
-    if (imageToCrop.isNull()) {
+    if (!m_viewPanel->hasImages()) {
         QMessageBox::information(this, "Thông báo", "Không có ảnh nào trong vùng xem để cắt.");
         return;
     }
-    CropDialog dialog(imageToCrop, this);
-    connect(&dialog, &CropDialog::exportImageRequested, this, &SidePanel::exportImageRequested);
-
-    if (dialog.exec() == QDialog::Accepted) {
-        QImage finalImage = dialog.getFinalImage();
-        if(!finalImage.isNull()) {
-            m_viewPanel->setImages({finalImage});
-            m_viewPanel->fitToWindow();
+    renderFullComposite([this](const QImage &imageToCrop) {
+        if (imageToCrop.isNull()) return; // Đã hủy
+        CropDialog dialog(imageToCrop, this);
+        connect(&dialog, &CropDialog::exportImageRequested, this, &SidePanel::exportImageRequested);
+
+        if (dialog.exec() == QDialog::Accepted) {
+            QImage finalImage = dialog.getFinalImage();
+            if(!finalImage.isNull()) {
+                m_viewPanel->setImages({finalImage});
+                // Ảnh ghép đã cắt không thuộc kho: ID rỗng để lần đổi dấu chọn sau thay nó bằng các ảnh đã đánh dấu
+                m_viewImageIds = QStringList{QString()};
+                m_viewPanel->fitToWindow();
+            }
         }
-    }
+    });
 }
 
 void SidePanel::onViewAndCropItem(QListWidgetItem* item)
 {
-    QString filePath = item->data(Qt::UserRole).toString();
-    QImage imageToCrop(filePath);
+    QImage imageToCrop = imageForItem(item);
 
     if (!imageToCrop.isNull()) {
         CropDialog dialog(imageToCrop, this);
@@ -173,13 +243,17 @@ void SidePanel::onViewAndCropItem(QListWidgetItem* item)
         if (dialog.exec() == QDialog::Accepted) {
             QImage finalImage = dialog.getFinalImage();
             if (!finalImage.isNull()) {
-                QThreadPool::globalInstance()->start([this, filePath, finalImage]() {
-                    bool success = finalImage.save(filePath, "PNG");
-                    QMetaObject::invokeMethod(this, "onCroppedImageSaveFinished", Qt::QueuedConnection,
-                                              Q_ARG(bool, success),
-                                              Q_ARG(QString, filePath),
-                                              Q_ARG(QImage, finalImage));
-                });
+                // Kho tự ghi ảnh ra đĩa khi cần (vượt ngân sách bộ nhớ)
+                const QString imageId = item->data(Qt::UserRole).toString();
+                m_imageStore->replace(imageId, finalImage);
+                LibraryWidget* lw = m_libraryPanel->getLibraryWidget();
+                QPixmap thumbnail = QPixmap::fromImage(finalImage.scaled(lw->iconSize(), Qt::KeepAspectRatio, Qt::SmoothTransformation));
+                item->setIcon(QIcon(thumbnail));
+                // Chỉ xử lý lại ảnh này nếu nó đang nằm trong ảnh ghép
+                int viewIndex = m_viewImageIds.indexOf(imageId);
+                if (viewIndex >= 0) {
+                    m_viewPanel->replaceImage(viewIndex, finalImage);
+                }
             }
         }
     }
@@ -202,19 +276,13 @@ void SidePanel::onDeleteChecked()
         QMessageBox::Yes | QMessageBox::No);
 
     if (ret == QMessageBox::Yes) {
-        for (QListWidgetItem* item : itemsToDelete) {
-            QString filePath = item->data(Qt::UserRole).toString();
-            emit fileDeleted(filePath); 
-            delete lw->takeItem(lw->row(item));
-        }
-        onLibraryItemsChanged(nullptr);
+        deleteItems(itemsToDelete);
     }
 }
 
 void SidePanel::onQuickExportItem(QListWidgetItem* item)
 {
-    QString filePath = item->data(Qt::UserRole).toString();
-    QImage imageToExport(filePath);
+    QImage imageToExport = imageForItem(item);
     if (!imageToExport.isNull()) {
         emit exportImageRequested(imageToExport);
     }
@@ -223,17 +291,39 @@ void SidePanel::onQuickExportItem(QListWidgetItem* item)
 void SidePanel::onLibraryItemsChanged(QListWidgetItem* item)
 {
     Q_UNUSED(item);
-    QList<QImage> checkedImages;
+    // Chỉ so ID theo thứ tự thư viện, không lấy ảnh
+    QStringList checkedIds;
     LibraryWidget* lw = m_libraryPanel->getLibraryWidget();
     for (int i = 0; i < lw->count(); ++i) {
         QListWidgetItem* currentItem = lw->item(i);
         if (currentItem->checkState() == Qt::Checked) {
-            QString filePath = currentItem->data(Qt::UserRole).toString();
-            checkedImages.append(QImage(filePath));
+            checkedIds.append(currentItem->data(Qt::UserRole).toString());
         }
     }
-    m_viewPanel->setImages(checkedImages);
-    if (!checkedImages.isEmpty()) {
+    if (checkedIds == m_viewImageIds) return;
+
+    // Thư viện không đổi thứ tự item nên m_viewImageIds (sau khi bỏ ảnh đã bỏ dấu) luôn là dãy con
+    // của checkedIds: bỏ từ cuối lên, rồi chèn ảnh mới đánh dấu vào đúng vị trí.
+    const QSet<QString> checkedSet(checkedIds.cbegin(), checkedIds.cend());
+    for (int i = m_viewImageIds.count() - 1; i >= 0; --i) {
+        if (!checkedSet.contains(m_viewImageIds[i])) {
+            m_viewImageIds.removeAt(i);
+            m_viewPanel->removeImageAt(i);
+        }
+    }
+    int viewIndex = 0;
+    for (const QString &imageId : checkedIds) {
+        if (viewIndex < m_viewImageIds.count() && m_viewImageIds[viewIndex] == imageId) {
+            viewIndex++;
+            continue;
+        }
+        QImage image = m_imageStore ? m_imageStore->image(imageId) : QImage();
+        if (image.isNull()) continue;
+        m_viewImageIds.insert(viewIndex, imageId);
+        m_viewPanel->insertImage(viewIndex, image);
+        viewIndex++;
+    }
+    if (!m_viewImageIds.isEmpty()) {
         m_viewPanel->fitToWindow();
     }
 }
@@ -254,30 +344,20 @@ void SidePanel::applyStylesToViewPanel(const StyleOptions& options)
 
 void SidePanel::onExportClicked()
 {
-    QImage finalImage = m_viewPanel->getCompositedImage();
-    if (!finalImage.isNull()) {
-        emit exportImageRequested(finalImage);
-    } else {
+    if (!m_viewPanel->hasImages()) {
         QMessageBox::warning(this, "Lỗi", "Không có ảnh để xuất.");
+        return;
     }
-}
-
-void SidePanel::onCroppedImageSaveFinished(bool success, const QString& filePath, const QImage& savedImage)
-{
-    if (success) {
-        LibraryWidget* lw = m_libraryPanel->getLibraryWidget();
-        for (int i = 0; i < lw->count(); ++i) {
-            QListWidgetItem* item = lw->item(i);
-            if (item->data(Qt::UserRole).toString() == filePath) {
-                QPixmap thumbnail = QPixmap::fromImage(savedImage.scaled(lw->iconSize(), Qt::KeepAspectRatio, Qt::SmoothTransformation));
-                item->setIcon(QIcon(thumbnail));
-                onLibraryItemsChanged(item);
-                break;
-            }
-        }
-    } else {
-        QMessageBox::critical(this, "Lỗi", "Không thể lưu ảnh đã cắt.");
+    const QSize size = m_viewPanel->compositeSize();
+    if (m_tiledExportThreshold > 0 && qint64(size.width()) * size.height() > m_tiledExportThreshold) {
+        emit exportTiledRequested(m_viewPanel->createTiledCompositor());
+        return;
     }
+    renderFullComposite([this](const QImage &finalImage) {
+        if (!finalImage.isNull()) {
+            emit exportImageRequested(finalImage);
+        }
+    });
 }
 
 LibraryWidget* SidePanel::getLibraryWidget() const { return m_libraryPanel->getLibraryWidget(); }
@@ -1,8 +1,10 @@
-// sidepanel.h - Version 2.4 (Thêm phím Delete)
+// sidepanel.h - Version 2.9 (Chặn dựng ảnh ghép chồng nhau)
 #ifndef SIDEPANEL_H
 #define SIDEPANEL_H
 
 #include <QWidget>
+#include <functional>
+#include <memory>
 #include "stylepanel.h" 
 
 class LibraryPanel;
@@ -10,6 +12,8 @@ class ViewPanel;
 class ExportPanel;
 class QListWidgetItem;
 class LibraryWidget;
+class ImageStore;
+class TiledCompositor;
 
 class SidePanel : public QWidget
 {
@@ -21,15 +25,18 @@ public:
     LibraryWidget* getLibraryWidget() const;
     ViewPanel* getViewPanel() const;
     ExportPanel* getExportPanel() const;
+    // Mỗi item thư viện giữ ID ảnh trong kho (Qt::UserRole)
+    void setImageStore(std::shared_ptr<ImageStore> store);
+    // Xóa thư viện, kho ảnh và vùng xem (khi mở video mới)
+    void clearLibrary();
+    // Ảnh ghép có số điểm ảnh vượt ngưỡng được xuất theo tile (exportTiledRequested); 0 = luôn dựng cả ảnh
+    void setTiledExportThreshold(qint64 pixels);
 
 signals:
     void exportImageRequested(const QImage& image);
+    void exportTiledRequested(std::shared_ptr<TiledCompositor> compositor);
     void addImagesToLibraryRequested();
     void newImagesDropped(const QList<QUrl>& urls);
-    void fileDeleted(const QString& filePath); 
-
-public slots:
-    void onCroppedImageSaveFinished(bool success, const QString& filePath, const QImage& savedImage);
 
 private slots:
     void onViewAndCropItem(QListWidgetItem* item);
@@ -44,11 +51,22 @@ private slots:
 
 private:
     void setupUi();
+    QImage imageForItem(QListWidgetItem* item) const;
+    void deleteItems(const QList<QListWidgetItem*> &items);
+    // Dựng ảnh ghép độ phân giải gốc với hộp thoại tiến độ; onDone nhận ảnh rỗng nếu người dùng hủy.
+    // Bỏ qua nếu lần dựng trước chưa xong.
+    void renderFullComposite(std::function<void(const QImage&)> onDone);
 
     LibraryPanel* m_libraryPanel;
     ViewPanel* m_viewPanel;
     StylePanel* m_stylePanel;
     ExportPanel* m_exportPanel;
+    std::shared_ptr<ImageStore> m_imageStore;
+    // ID của các ảnh đang nằm trong ViewPanel, cùng thứ tự
+    QStringList m_viewImageIds;
+    qint64 m_tiledExportThreshold = 0;
+    // Đang chờ fullRenderFinished: chỉ một lần xuất/cắt ảnh ghép chạy tại một thời điểm
+    bool m_fullRenderInFlight = false;
 };
 
 #endif // SIDEPANEL_H
@@ -0,0 +1,109 @@
+// tst_seektoframe.cpp - Version 1.0
+// Kiểm tra VideoProcessor::seekToFrame trên hai clip nhỏ do ffmpeg tạo lúc chạy:
+// CFR (25 fps) và VFR (khoảng cách pts tăng dần). Bỏ qua nếu không tìm thấy ffmpeg.
+#include <QtTest>
+#include <QProcess>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <atomic>
+#include "videoprocessor.h"
+
+namespace {
+const int kFrameCount = 60;
+const int kGopSize = 12;
+
+// Cả hai clip dùng Matroska (time base 1/1000) nên pts là mili giây chính xác
+int64_t expectedPts(const QString &clip, int frameNumber)
+{
+    const int64_t n = frameNumber;
+    if (clip == "cfr") return n * 40;
+    return n * n + n * 20; // Khoảng cách 21, 23, 25, ... ms
+}
+}
+
+class TestSeekToFrame : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void seekToFrame_data();
+    void seekToFrame();
+
+private:
+    bool makeClip(const QString &filePath, const QStringList &extraArgs);
+
+    QTemporaryDir m_dir;
+    QString m_ffmpeg;
+};
+
+bool TestSeekToFrame::makeClip(const QString &filePath, const QStringList &extraArgs)
+{
+    QStringList args = {"-v", "error", "-y", "-f", "lavfi", "-i", "testsrc=size=160x120:rate=25",
+                        "-frames:v", QString::number(kFrameCount), "-c:v", "mpeg4", "-g", QString::number(kGopSize),
+                        "-bf", "0"};
+    args << extraArgs << filePath;
+    QProcess process;
+    process.start(m_ffmpeg, args);
+    if (!process.waitForFinished(30000) || process.exitStatus() != QProcess::NormalExit || process.exitCode() != 0) {
+        qWarning() << "ffmpeg failed:" << process.readAllStandardError();
+        return false;
+    }
+    return true;
+}
+
+void TestSeekToFrame::initTestCase()
+{
+    // Chỉ mục frame được cache trong thư mục thử nghiệm, không đụng tới cache của người dùng
+    QStandardPaths::setTestModeEnabled(true);
+    m_ffmpeg = QStandardPaths::findExecutable("ffmpeg");
+    if (m_ffmpeg.isEmpty()) QSKIP("ffmpeg not found in PATH");
+    QVERIFY(m_dir.isValid());
+
+    QVERIFY(makeClip(m_dir.filePath("cfr.mkv"), {}));
+    // setpts đặt mốc thời gian không đều; passthrough giữ nguyên (ffmpeg cũ dùng -vsync)
+    const QStringList vfr = {"-vf", "settb=1/1000,setpts=N*N+N*20"};
+    if (!makeClip(m_dir.filePath("vfr.mkv"), vfr + QStringList{"-fps_mode", "passthrough"})) {
+        QVERIFY(makeClip(m_dir.filePath("vfr.mkv"), vfr + QStringList{"-vsync", "passthrough"}));
+    }
+}
+
+void TestSeekToFrame::seekToFrame_data()
+{
+    QTest::addColumn<QString>("clip");
+    QTest::addColumn<bool>("useIndex");
+
+    // Không có chỉ mục thì số frame suy từ fps: chỉ đúng với CFR
+    QTest::newRow("cfr-estimated") << "cfr" << false;
+    QTest::newRow("cfr-index") << "cfr" << true;
+    QTest::newRow("vfr-index") << "vfr" << true;
+}
+
+void TestSeekToFrame::seekToFrame()
+{
+    QFETCH(QString, clip);
+    QFETCH(bool, useIndex);
+    const QString filePath = m_dir.filePath(clip + ".mkv");
+
+    VideoProcessor processor;
+    QVERIFY(processor.openFile(filePath));
+    if (useIndex) {
+        std::atomic<bool> cancel = false;
+        std::shared_ptr<const FrameIndex> index = FrameIndex::loadOrBuild(filePath, cancel);
+        QVERIFY(index);
+        QCOMPARE(index->frameCount(), kFrameCount);
+        processor.setFrameIndex(index);
+    }
+
+    // Tới, lùi, sát trước/sau keyframe, frame cuối: mỗi lần tua dùng lại cùng decoder
+    const QList<int> frames = {0, 1, kGopSize - 1, kGopSize, kGopSize + 1, 30, kFrameCount - 1, 5, 0, 2 * kGopSize};
+    for (int frameNumber : frames) {
+        const FrameData frame = processor.seekToFrame(frameNumber);
+        QVERIFY2(!frame.image.isNull(), qPrintable(QString("frame %1").arg(frameNumber)));
+        QCOMPARE(frame.frameNumber, frameNumber);
+        QCOMPARE(frame.pts, expectedPts(clip, frameNumber));
+    }
+}
+
+QTEST_GUILESS_MAIN(TestSeekToFrame)
+#include "tst_seektoframe.moc"
@@ -0,0 +1,147 @@
+// thumbnailgenerator.cpp - Version 1.1
+// Change-log:
+// - Version 1.1:
+//   - Dùng kMicrosecondTimeBase (avtime.h) và FrameIndex::cacheFilePath thay cho bản sao tại chỗ.
+//   - Log "Thumbnails generated" chuyển sang lcPerf.
+#include "thumbnailgenerator.h"
+#include "videoprocessor.h"
+#include "frameindex.h"
+#include "avtime.h"
+#include "perflog.h"
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QPromise>
+#include <QSaveFile>
+#include <QtConcurrent>
+
+namespace {
+const int kThumbnailCount = 100;
+const QSize kThumbnailSize(160, 90);
+const quint32 kThumbMagic = 0x54484d42; // "THMB"
+const quint32 kThumbVersion = 1;
+const int kMemoryCacheFiles = 4;
+}
+
+ThumbnailGenerator::ThumbnailGenerator(QObject *parent) : QObject(parent)
+{
+    m_memoryCache.setMaxCost(kMemoryCacheFiles);
+    m_watcher = new QFutureWatcher<Thumbnail>(this);
+    connect(m_watcher, &QFutureWatcher<Thumbnail>::resultReadyAt, this, &ThumbnailGenerator::onResultReady);
+    connect(m_watcher, &QFutureWatcher<Thumbnail>::finished, this, &ThumbnailGenerator::onFinished);
+}
+
+ThumbnailGenerator::~ThumbnailGenerator()
+{
+    cancel();
+}
+
+void ThumbnailGenerator::start(const QString &filePath, qint64 durationUs)
+{
+    cancel();
+    m_filePath = filePath;
+    if (const QList<Thumbnail> *cached = m_memoryCache.object(filePath)) {
+        for (const Thumbnail &thumbnail : *cached) emit thumbnailReady(thumbnail);
+        return;
+    }
+    if (durationUs <= 0) return;
+    m_watcher->setFuture(QtConcurrent::run(&ThumbnailGenerator::generate, filePath, durationUs));
+}
+
+void ThumbnailGenerator::cancel()
+{
+    // Tác vụ nền tự dừng ở ảnh kế tiếp; kết quả cũ không còn được chuyển tới nữa
+    m_watcher->cancel();
+    m_watcher->setFuture(QFuture<Thumbnail>());
+    m_filePath.clear();
+}
+
+void ThumbnailGenerator::onResultReady(int index)
+{
+    emit thumbnailReady(m_watcher->resultAt(index));
+}
+
+void ThumbnailGenerator::onFinished()
+{
+    QFuture<Thumbnail> future = m_watcher->future();
+    if (m_filePath.isEmpty() || !future.isFinished() || future.isCanceled() || future.resultCount() == 0) return;
+    m_memoryCache.insert(m_filePath, new QList<Thumbnail>(future.results()));
+}
+
+void ThumbnailGenerator::generate(QPromise<Thumbnail> &promise, const QString &filePath, qint64 durationUs)
+{
+    QString cachePath = FrameIndex::cacheFilePath(filePath, QStringLiteral("thumbnails"), QStringLiteral(".thumbs"));
+    if (!cachePath.isEmpty() && loadCache(promise, cachePath, filePath)) return;
+
+    QElapsedTimer timer;
+    timer.start();
+    VideoProcessor processor;
+    if (!processor.openFile(filePath)) return;
+    // Chỉ giải mã keyframe ở độ phân giải nhỏ nhất đủ cho ảnh thu nhỏ
+    processor.setOutputSize(kThumbnailSize);
+    processor.setScrubMode(true);
+    AVRational timeBase = processor.getTimeBase();
+    if (timeBase.den == 0) return;
+
+    QList<Thumbnail> thumbnails;
+    int64_t lastPts = AV_NOPTS_VALUE;
+    for (int i = 0; i < kThumbnailCount; ++i) {
+        if (promise.isCanceled()) return;
+        qint64 targetUs = durationUs * (2 * i + 1) / (2 * kThumbnailCount);
+        FrameData frame = processor.scrubTo(targetUs);
+        // GOP dài: nhiều mốc rơi vào cùng một keyframe
+        if (frame.image.isNull() || frame.pts == lastPts) continue;
+        lastPts = frame.pts;
+
+        Thumbnail thumbnail;
+        thumbnail.timeUs = av_rescale_q(frame.pts, timeBase, kMicrosecondTimeBase);
+        thumbnail.image = frame.image.copy(); // Tách khỏi FramePool của processor tạm
+        promise.addResult(thumbnail);
+        thumbnails.append(thumbnail);
+    }
+    qCDebug(lcPerf) << "Thumbnails generated:" << thumbnails.size() << "in" << timer.elapsed() << "ms";
+    if (!cachePath.isEmpty() && !thumbnails.isEmpty()) saveCache(thumbnails, cachePath, filePath);
+}
+
+bool ThumbnailGenerator::loadCache(QPromise<Thumbnail> &promise, const QString &cachePath, const QString &filePath)
+{
+    QFile file(cachePath);
+    if (!file.open(QIODevice::ReadOnly)) return false;
+    QDataStream in(&file);
+    QFileInfo fileInfo(filePath);
+
+    quint32 magic = 0, version = 0, count = 0;
+    qint64 mtime = 0, size = 0;
+    in >> magic >> version >> mtime >> size >> count;
+    if (magic != kThumbMagic || version != kThumbVersion) return false;
+    if (mtime != fileInfo.lastModified().toMSecsSinceEpoch() || size != fileInfo.size()) return false;
+
+    QList<Thumbnail> thumbnails;
+    for (quint32 i = 0; i < count; ++i) {
+        Thumbnail thumbnail;
+        in >> thumbnail.timeUs >> thumbnail.image;
+        if (in.status() != QDataStream::Ok || thumbnail.image.isNull()) return false;
+        thumbnails.append(thumbnail);
+    }
+    // Chỉ chuyển kết quả khi cả file hợp lệ, tránh trộn với ảnh trích lại
+    for (const Thumbnail &thumbnail : thumbnails) promise.addResult(thumbnail);
+    return !thumbnails.isEmpty();
+}
+
+void ThumbnailGenerator::saveCache(const QList<Thumbnail> &thumbnails, const QString &cachePath, const QString &filePath)
+{
+    QFileInfo fileInfo(filePath);
+    QSaveFile file(cachePath);
+    if (!file.open(QIODevice::WriteOnly)) return;
+    QDataStream out(&file);
+    out << kThumbMagic << kThumbVersion
+        << qint64(fileInfo.lastModified().toMSecsSinceEpoch()) << qint64(fileInfo.size())
+        << quint32(thumbnails.size());
+    for (const Thumbnail &thumbnail : thumbnails) {
+        out << thumbnail.timeUs << thumbnail.image;
+    }
+    file.commit();
+}
@@ -0,0 +1,47 @@
+// thumbnailgenerator.h - Version 1.1
+// Trích ảnh thu nhỏ (keyframe) cách đều nhau trên toàn bộ video ở nền, bằng một VideoProcessor
+// riêng để không ảnh hưởng luồng phát. Kết quả được giữ trong bộ nhớ và ghi vào thư mục cache.
+#ifndef THUMBNAILGENERATOR_H
+#define THUMBNAILGENERATOR_H
+
+#include <QObject>
+#include <QImage>
+#include <QCache>
+#include <QFutureWatcher>
+
+struct Thumbnail {
+    qint64 timeUs = 0; // Thời điểm thật của keyframe (micro giây)
+    QImage image;
+};
+
+class ThumbnailGenerator : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ThumbnailGenerator(QObject *parent = nullptr);
+    ~ThumbnailGenerator();
+
+    // Hủy lần trích trước (nếu có) và bắt đầu cho file mới
+    void start(const QString &filePath, qint64 durationUs);
+    void cancel();
+
+signals:
+    // Phát ra lần lượt trên luồng GUI khi từng ảnh sẵn sàng
+    void thumbnailReady(const Thumbnail &thumbnail);
+
+private slots:
+    void onResultReady(int index);
+    void onFinished();
+
+private:
+    static void generate(QPromise<Thumbnail> &promise, const QString &filePath, qint64 durationUs);
+    static bool loadCache(QPromise<Thumbnail> &promise, const QString &cachePath, const QString &filePath);
+    static void saveCache(const QList<Thumbnail> &thumbnails, const QString &cachePath, const QString &filePath);
+
+    QFutureWatcher<Thumbnail> *m_watcher;
+    QString m_filePath;
+    QCache<QString, QList<Thumbnail>> m_memoryCache; // Theo đường dẫn file, giữ vài video gần nhất
+};
+
+#endif // THUMBNAILGENERATOR_H
@@ -0,0 +1,96 @@
+// thumbnailstrip.cpp - Version 1.1
+// Change-log:
+// - Version 1.1: Vẽ khoảng vào/ra của chụp loạt đè lên dải ảnh.
+#include "thumbnailstrip.h"
+#include <QPainter>
+#include <QResizeEvent>
+#include <algorithm>
+
+ThumbnailStrip::ThumbnailStrip(QWidget *parent) : QWidget(parent)
+{
+    setFixedHeight(36);
+    setAttribute(Qt::WA_OpaquePaintEvent);
+}
+
+void ThumbnailStrip::reset(qint64 durationUs)
+{
+    m_thumbnails.clear();
+    m_duration = durationUs;
+    m_stripValid = false;
+    update();
+}
+
+void ThumbnailStrip::addThumbnail(const Thumbnail &thumbnail)
+{
+    auto it = std::lower_bound(m_thumbnails.begin(), m_thumbnails.end(), thumbnail.timeUs,
+                               [](const Thumbnail &t, qint64 timeUs) { return t.timeUs < timeUs; });
+    if (it != m_thumbnails.end() && it->timeUs == thumbnail.timeUs) return;
+    m_thumbnails.insert(it, thumbnail);
+    m_stripValid = false;
+    update();
+}
+
+const Thumbnail *ThumbnailStrip::thumbnailNear(qint64 timeUs) const
+{
+    if (m_thumbnails.empty()) return nullptr;
+    auto it = std::lower_bound(m_thumbnails.begin(), m_thumbnails.end(), timeUs,
+                               [](const Thumbnail &t, qint64 value) { return t.timeUs < value; });
+    if (it == m_thumbnails.end()) return &m_thumbnails.back();
+    if (it != m_thumbnails.begin() && timeUs - (it - 1)->timeUs < it->timeUs - timeUs) --it;
+    return &*it;
+}
+
+void ThumbnailStrip::setRange(qint64 inUs, qint64 outUs)
+{
+    m_inUs = inUs;
+    m_outUs = outUs;
+    update();
+}
+
+void ThumbnailStrip::paintEvent(QPaintEvent *)
+{
+    if (!m_stripValid) renderStrip();
+    QPainter painter(this);
+    painter.drawPixmap(0, 0, m_strip);
+    if (m_duration <= 0 || (m_inUs < 0 && m_outUs < 0)) return;
+
+    // Làm tối phần ngoài khoảng, viền vàng tại điểm vào/ra
+    const int inX = m_inUs >= 0 ? int(width() * double(m_inUs) / m_duration) : 0;
+    const int outX = m_outUs >= 0 ? int(width() * double(m_outUs) / m_duration) : width();
+    painter.fillRect(QRect(0, 0, inX, height()), QColor(0, 0, 0, 160));
+    painter.fillRect(QRect(outX, 0, width() - outX, height()), QColor(0, 0, 0, 160));
+    painter.setPen(QPen(QColor(241, 196, 15), 2));
+    if (m_inUs >= 0) painter.drawLine(inX, 0, inX, height());
+    if (m_outUs >= 0) painter.drawLine(outX, 0, outX, height());
+}
+
+void ThumbnailStrip::resizeEvent(QResizeEvent *event)
+{
+    m_stripValid = false;
+    QWidget::resizeEvent(event);
+}
+
+void ThumbnailStrip::renderStrip()
+{
+    const qreal dpr = devicePixelRatioF();
+    m_strip = QPixmap(size() * dpr);
+    m_strip.setDevicePixelRatio(dpr);
+    m_strip.fill(Qt::black);
+    m_stripValid = true;
+    if (m_thumbnails.empty() || m_duration <= 0 || width() <= 0) return;
+
+    // Mỗi ô giữ tỉ lệ của video; ô thứ i hiển thị ảnh gần thời điểm giữa ô nhất
+    QSize imageSize = m_thumbnails.front().image.size();
+    int cellWidth = qMax(8, height() * imageSize.width() / qMax(1, imageSize.height()));
+    int cells = (width() + cellWidth - 1) / cellWidth;
+
+    QPainter painter(&m_strip);
+    painter.setRenderHint(QPainter::SmoothPixmapTransform);
+    for (int i = 0; i < cells; ++i) {
+        QRect cell(i * cellWidth, 0, cellWidth, height());
+        qint64 timeUs = m_duration * (cell.center().x() + 0.5) / width();
+        if (const Thumbnail *thumbnail = thumbnailNear(timeUs)) {
+            painter.drawImage(cell, thumbnail->image);
+        }
+    }
+}
@@ -0,0 +1,41 @@
+// thumbnailstrip.h - Version 1.1
+// Dải ảnh thu nhỏ (filmstrip) vẽ dưới thanh thời gian của PlayerPanel.
+#ifndef THUMBNAILSTRIP_H
+#define THUMBNAILSTRIP_H
+
+#include <QWidget>
+#include <QPixmap>
+#include <vector>
+#include "thumbnailgenerator.h"
+
+class ThumbnailStrip : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit ThumbnailStrip(QWidget *parent = nullptr);
+
+    void reset(qint64 durationUs);
+    void addThumbnail(const Thumbnail &thumbnail);
+    // Ảnh có thời điểm gần timeUs nhất; nullptr nếu chưa có ảnh nào
+    const Thumbnail *thumbnailNear(qint64 timeUs) const;
+    // Đánh dấu khoảng vào/ra (chụp loạt); giá trị < 0 là chưa đặt
+    void setRange(qint64 inUs, qint64 outUs);
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+
+private:
+    void renderStrip();
+
+    std::vector<Thumbnail> m_thumbnails; // Sắp theo thời gian
+    qint64 m_duration = 0;
+    qint64 m_inUs = -1;
+    qint64 m_outUs = -1;
+    // Dải đã vẽ sẵn, chỉ vẽ lại khi thêm ảnh hoặc đổi kích thước
+    QPixmap m_strip;
+    bool m_stripValid = false;
+};
+
+#endif // THUMBNAILSTRIP_H
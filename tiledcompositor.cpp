@@ -0,0 +1,412 @@
+// tiledcompositor.cpp - Version 1.2
+// Change-log:
+// - Version 1.2: Log thời gian ghi/đỉnh bộ nhớ (logExport) chuyển sang lcPerf.
+// - Version 1.1:
+//   - PNG nén deflate thật qua zlib theo từng dải (bộ lọc Up), thay cho khối deflate lưu không nén.
+//   - Item được co giãn trước bằng QImage::scaled(SmoothTransformation) như ViewPanel (thay cho vẽ co
+//     giãn song tuyến qua QPainter, bị răng cưa khi thu nhỏ nhiều), giữ theo dải và bỏ khi đã đi qua.
+#include "tiledcompositor.h"
+#include "perflog.h"
+#include <QByteArray>
+#include <QDataStream>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QPainter>
+#include <QPainterPath>
+#include <QSaveFile>
+#include <QtMath>
+#include <cstring>
+#include <zlib.h>
+
+#if defined(Q_OS_WIN)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace {
+const int kPngChunkBytes = 256 * 1024; // Kích thước tối đa một chunk IDAT
+
+// Giải phóng z_stream trên mọi đường thoát
+struct DeflateStream {
+    z_stream stream{};
+    bool initialized = false;
+    ~DeflateStream() { if (initialized) deflateEnd(&stream); }
+};
+
+void appendBigEndian32(QByteArray &out, quint32 value)
+{
+    out.append(char(value >> 24)).append(char(value >> 16)).append(char(value >> 8)).append(char(value));
+}
+
+bool writePngChunk(QIODevice &device, const char *type, const QByteArray &data)
+{
+    QByteArray chunk;
+    chunk.reserve(data.size() + 12);
+    appendBigEndian32(chunk, static_cast<quint32>(data.size()));
+    chunk.append(type, 4);
+    chunk.append(data);
+    appendBigEndian32(chunk, static_cast<quint32>(crc32(0, reinterpret_cast<const Bytef *>(chunk.constData() + 4),
+                                                        static_cast<uInt>(data.size() + 4))));
+    return device.write(chunk) == chunk.size();
+}
+
+// Một trường IFD của TIFF; data đã mã hóa little-endian, ghi tại chỗ nếu vừa ô giá trị
+struct TiffField {
+    quint16 tag;
+    quint16 type;
+    quint64 count;
+    QByteArray data;
+};
+
+enum TiffType : quint16 { TiffShort = 3, TiffLong = 4, TiffLong8 = 16 };
+
+TiffField tiffShorts(quint16 tag, std::initializer_list<quint16> values)
+{
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setByteOrder(QDataStream::LittleEndian);
+    for (quint16 value : values) out << value;
+    return {tag, TiffShort, static_cast<quint64>(values.size()), data};
+}
+
+TiffField tiffLongs(quint16 tag, const QList<quint64> &values, bool bigTiff)
+{
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setByteOrder(QDataStream::LittleEndian);
+    for (quint64 value : values) {
+        if (bigTiff) out << value;
+        else out << static_cast<quint32>(value);
+    }
+    return {tag, bigTiff ? TiffLong8 : TiffLong, static_cast<quint64>(values.size()), data};
+}
+
+void logExport(const char *what, const QSize &size, const QElapsedTimer &timer)
+{
+    const qint64 peak = TiledCompositor::peakResidentBytes();
+    qCDebug(lcPerf) << what << size << "written in" << timer.elapsed() << "ms, process peak RSS"
+             << (peak >= 0 ? peak / (1024 * 1024) : -1) << "MB";
+}
+}
+
+TiledCompositor::TiledCompositor(const QSize &size, const QList<Item> &items, const QColor &backgroundColor, int cornerRadius)
+    : m_size(size), m_items(items), m_backgroundColor(backgroundColor), m_cornerRadius(qMax(0, cornerRadius))
+{
+}
+
+QImage TiledCompositor::scaledItem(const QImage &image, const QSize &target, bool cropToFill)
+{
+    if (image.isNull() || target == image.size()) return image;
+
+    if (!cropToFill) {
+        return image.scaled(target, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    }
+
+    // === GIẢI PHÁP 2: Logic CROP ảnh thủ công ===
+    // 1. Phóng to ảnh để lấp đầy khung tùy chỉnh
+    QImage tempScaled = image.scaled(target, Qt::KeepAspectRatioByExpanding, Qt::SmoothTransformation);
+
+    // 2. Tính toán vùng cần cắt (chính giữa)
+    int x = (tempScaled.width() - target.width()) / 2;
+    int y = (tempScaled.height() - target.height()) / 2;
+    QRect cropRect(x, y, target.width(), target.height());
+
+    // 3. Cắt và lấy ảnh cuối cùng
+    return tempScaled.copy(cropRect);
+}
+
+QSize TiledCompositor::size() const
+{
+    return m_size;
+}
+
+void TiledCompositor::setPngCompression(int level)
+{
+    m_pngCompression = qBound(0, level, 9);
+}
+
+QImage TiledCompositor::renderTile(const QRect &rect) const
+{
+    ScaledCache cache;
+    return renderTile(rect, cache);
+}
+
+void TiledCompositor::evictAbove(ScaledCache &cache, int top) const
+{
+    for (auto it = cache.begin(); it != cache.end();) {
+        if (m_items[it.key()].targetRect.bottom() < top) it = cache.erase(it);
+        else ++it;
+    }
+}
+
+QImage TiledCompositor::renderTile(const QRect &rect, ScaledCache &cache) const
+{
+    QImage tile(rect.size(), QImage::Format_ARGB32_Premultiplied);
+    if (tile.isNull()) return QImage();
+    tile.fill(m_backgroundColor);
+
+    QPainter painter(&tile);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.setRenderHint(QPainter::SmoothPixmapTransform);
+    painter.translate(-rect.topLeft());
+
+    for (int i = 0; i < m_items.count(); ++i) {
+        const Item &item = m_items[i];
+        if (!item.targetRect.intersects(rect)) continue;
+        auto cached = cache.find(i);
+        if (cached == cache.end()) {
+            cached = cache.insert(i, scaledItem(item.image, item.targetRect.size(), item.cropToFill));
+        }
+        const QImage &scaled = cached.value();
+        // Bán kính bo góc tính như ViewPanel::renderComposite để ảnh xuất khớp với ảnh xem trước
+        const QRect &target = item.targetRect;
+        int radius = m_cornerRadius > 0 ? (qMin(target.width(), target.height()) * m_cornerRadius / 100) : 0;
+        if (radius > 0) {
+            QPainterPath path;
+            path.addRoundedRect(target, radius, radius);
+            painter.setClipPath(path);
+        }
+        painter.drawImage(target.topLeft(), scaled);
+        if (radius > 0) painter.setClipping(false);
+    }
+    painter.end();
+
+    // Premultiplied để vẽ nhanh, đổi sang alpha thẳng theo từng tile
+    return tile.convertToFormat(QImage::Format_RGBA8888);
+}
+
+bool TiledCompositor::writePng(const QString &filePath, const std::atomic<bool> *cancel,
+                               const ProgressCallback &progress) const
+{
+    if (m_size.isEmpty()) return false;
+    QElapsedTimer timer;
+    timer.start();
+
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Cannot open" << filePath << "for writing:" << file.errorString();
+        return false;
+    }
+
+    const int width = m_size.width();
+    const int height = m_size.height();
+    file.write("\x89PNG\r\n\x1a\n", 8);
+
+    QByteArray header;
+    appendBigEndian32(header, width);
+    appendBigEndian32(header, height);
+    header.append(char(8));  // 8 bit mỗi kênh
+    header.append(char(6));  // RGBA
+    header.append(char(0));  // deflate
+    header.append(char(0));  // bộ lọc thích ứng
+    header.append(char(0));  // không xen kẽ
+    if (!writePngChunk(file, "IHDR", header)) return false;
+
+    DeflateStream deflater;
+    if (deflateInit(&deflater.stream, m_pngCompression) != Z_OK) return false;
+    deflater.initialized = true;
+    z_stream &zs = deflater.stream;
+
+    // Đầu ra zlib gom vào out; đầy thì ghi thành một chunk IDAT
+    QByteArray out(kPngChunkBytes, Qt::Uninitialized);
+    zs.next_out = reinterpret_cast<Bytef *>(out.data());
+    zs.avail_out = static_cast<uInt>(out.size());
+    auto flushChunk = [&]() {
+        const qsizetype produced = out.size() - zs.avail_out;
+        zs.next_out = reinterpret_cast<Bytef *>(out.data());
+        zs.avail_out = static_cast<uInt>(out.size());
+        return produced == 0 || writePngChunk(file, "IDAT", QByteArray::fromRawData(out.constData(), produced));
+    };
+    auto compress = [&](const QByteArray &data, int flush) {
+        zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.constData()));
+        zs.avail_in = static_cast<uInt>(data.size());
+        for (;;) {
+            const int result = deflate(&zs, flush);
+            if (result == Z_STREAM_ERROR) return false;
+            if (zs.avail_out == 0) {
+                if (!flushChunk()) return false;
+                continue;
+            }
+            if (flush == Z_FINISH ? result == Z_STREAM_END : zs.avail_in == 0) break;
+        }
+        return flush != Z_FINISH || flushChunk();
+    };
+
+    const qsizetype rowBytes = qsizetype(width) * 4;
+    const int bandCount = (height + kPngBandRows - 1) / kPngBandRows;
+    QByteArray previousRow(rowBytes, '\0');
+    QByteArray raw;
+    ScaledCache cache;
+
+    for (int band = 0; band < bandCount; ++band) {
+        if (cancel && *cancel) return false;
+        const int y = band * kPngBandRows;
+        const int rows = qMin(kPngBandRows, height - y);
+        evictAbove(cache, y);
+        const QImage tile = renderTile(QRect(0, y, width, rows), cache);
+        if (tile.isNull()) return false;
+
+        // Mỗi hàng: byte bộ lọc 2 (Up) + hiệu với hàng trên; hàng đầu so với hàng 0 (= không lọc)
+        raw.resize(rows * (rowBytes + 1));
+        char *dst = raw.data();
+        for (int row = 0; row < rows; ++row) {
+            const char *line = reinterpret_cast<const char *>(tile.constScanLine(row));
+            const char *above = previousRow.constData();
+            *dst++ = char(2);
+            for (qsizetype i = 0; i < rowBytes; ++i) *dst++ = char(line[i] - above[i]);
+            memcpy(previousRow.data(), line, rowBytes);
+        }
+        if (!compress(raw, band == bandCount - 1 ? Z_FINISH : Z_NO_FLUSH)) return false;
+        if (progress) progress(band + 1, bandCount);
+    }
+
+    if (!writePngChunk(file, "IEND", QByteArray())) return false;
+    if (!file.commit()) {
+        qWarning() << "Failed to write" << filePath << ":" << file.errorString();
+        return false;
+    }
+    logExport("Streamed PNG", m_size, timer);
+    return true;
+}
+
+bool TiledCompositor::writeTiledTiff(const QString &filePath, const std::atomic<bool> *cancel,
+                                     const ProgressCallback &progress) const
+{
+    if (m_size.isEmpty()) return false;
+    QElapsedTimer timer;
+    timer.start();
+
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Cannot open" << filePath << "for writing:" << file.errorString();
+        return false;
+    }
+
+    const int tilesAcross = (m_size.width() + kTileSize - 1) / kTileSize;
+    const int tilesDown = (m_size.height() + kTileSize - 1) / kTileSize;
+    const int tileCount = tilesAcross * tilesDown;
+    // Deflate có thể lớn hơn dữ liệu gốc một chút: chừa lề trước khi quyết định offset 32 bit
+    const quint64 worstCase = quint64(tileCount) * (kTileSize * kTileSize * 4 + 1024);
+    const bool bigTiff = worstCase > 0xF0000000ull;
+
+    QDataStream out(&file);
+    out.setByteOrder(QDataStream::LittleEndian);
+    out.writeRawData("II", 2);
+    qint64 ifdOffsetPos;
+    if (bigTiff) {
+        out << quint16(43) << quint16(8) << quint16(0);
+        ifdOffsetPos = file.pos();
+        out << quint64(0);
+    } else {
+        out << quint16(42);
+        ifdOffsetPos = file.pos();
+        out << quint32(0);
+    }
+
+    QList<quint64> tileOffsets;
+    QList<quint64> tileByteCounts;
+    tileOffsets.reserve(tileCount);
+    tileByteCounts.reserve(tileCount);
+    ScaledCache cache;
+    for (int ty = 0; ty < tilesDown; ++ty) {
+        evictAbove(cache, ty * kTileSize);
+        for (int tx = 0; tx < tilesAcross; ++tx) {
+            if (cancel && *cancel) return false;
+            // Tile ở mép vẫn đủ kích thước; phần thừa ngoài ảnh bị trình đọc bỏ qua
+            const QImage tile = renderTile(QRect(tx * kTileSize, ty * kTileSize, kTileSize, kTileSize), cache);
+            if (tile.isNull()) return false;
+            const QByteArray compressed = qCompress(tile.constBits(), tile.sizeInBytes());
+            // qCompress thêm 4 byte độ dài trước luồng zlib
+            const qsizetype streamSize = compressed.size() - 4;
+            tileOffsets.append(static_cast<quint64>(file.pos()));
+            tileByteCounts.append(static_cast<quint64>(streamSize));
+            if (out.writeRawData(compressed.constData() + 4, streamSize) != streamSize) return false;
+        }
+        if (progress) progress((ty + 1) * tilesAcross, tileCount);
+    }
+
+    const QList<TiffField> fields = {
+        tiffLongs(256, {quint64(m_size.width())}, false),   // ImageWidth
+        tiffLongs(257, {quint64(m_size.height())}, false),  // ImageLength
+        tiffShorts(258, {8, 8, 8, 8}),                      // BitsPerSample
+        tiffShorts(259, {8}),                               // Compression: Adobe deflate
+        tiffShorts(262, {2}),                               // Photometric: RGB
+        tiffShorts(277, {4}),                               // SamplesPerPixel
+        tiffShorts(284, {1}),                               // PlanarConfiguration: xen kẽ
+        tiffLongs(322, {quint64(kTileSize)}, false),        // TileWidth
+        tiffLongs(323, {quint64(kTileSize)}, false),        // TileLength
+        tiffLongs(324, tileOffsets, bigTiff),               // TileOffsets
+        tiffLongs(325, tileByteCounts, bigTiff),            // TileByteCounts
+        tiffShorts(338, {2}),                               // ExtraSamples: alpha thẳng
+    };
+
+    // Giá trị không vừa ô của IFD được ghi trước, IFD ghi sau cùng
+    const int valueSize = bigTiff ? 8 : 4;
+    QList<quint64> valueOffsets;
+    for (const TiffField &field : fields) {
+        if (field.data.size() <= valueSize) {
+            valueOffsets.append(0);
+            continue;
+        }
+        if (file.pos() & 1) out << quint8(0); // Offset trong TIFF phải chẵn
+        valueOffsets.append(static_cast<quint64>(file.pos()));
+        out.writeRawData(field.data.constData(), field.data.size());
+    }
+
+    if (file.pos() & 1) out << quint8(0);
+    const quint64 ifdOffset = static_cast<quint64>(file.pos());
+    if (bigTiff) out << quint64(fields.size());
+    else out << quint16(fields.size());
+    for (int i = 0; i < fields.size(); ++i) {
+        const TiffField &field = fields[i];
+        out << field.tag << field.type;
+        if (bigTiff) out << field.count;
+        else out << static_cast<quint32>(field.count);
+        if (field.data.size() <= valueSize) {
+            QByteArray value = field.data;
+            value.append(QByteArray(valueSize - value.size(), '\0'));
+            out.writeRawData(value.constData(), valueSize);
+        } else if (bigTiff) {
+            out << valueOffsets[i];
+        } else {
+            out << static_cast<quint32>(valueOffsets[i]);
+        }
+    }
+    if (bigTiff) out << quint64(0);
+    else out << quint32(0); // Không còn IFD tiếp theo
+
+    file.seek(ifdOffsetPos);
+    if (bigTiff) out << ifdOffset;
+    else out << static_cast<quint32>(ifdOffset);
+
+    if (out.status() != QDataStream::Ok || !file.commit()) {
+        qWarning() << "Failed to write" << filePath << ":" << file.errorString();
+        return false;
+    }
+    logExport("Tiled TIFF", m_size, timer);
+    return true;
+}
+
+qint64 TiledCompositor::peakResidentBytes()
+{
+#if defined(Q_OS_WIN)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return static_cast<qint64>(counters.PeakWorkingSetSize);
+    }
+    return -1;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return -1;
+#if defined(Q_OS_MACOS)
+    return static_cast<qint64>(usage.ru_maxrss);         // macOS: byte
+#else
+    return static_cast<qint64>(usage.ru_maxrss) * 1024;  // Linux: KiB
+#endif
+#endif
+}
@@ -0,0 +1,66 @@
+// tiledcompositor.h - Version 1.1
+// Dựng ảnh ghép theo từng ô (tile) cố định và ghi thẳng ra file (PNG theo dải hàng, TIFF dạng tile),
+// nên bộ nhớ dùng không phụ thuộc kích thước ảnh ghép. Ảnh cần co giãn được co giãn một lần khi dải
+// đầu tiên chạm tới và bỏ khi đã đi qua, giống hệt cách ViewPanel dựng ảnh ghép trong bộ nhớ.
+#ifndef TILEDCOMPOSITOR_H
+#define TILEDCOMPOSITOR_H
+
+#include <QColor>
+#include <QImage>
+#include <QHash>
+#include <QList>
+#include <QRect>
+#include <QString>
+#include <atomic>
+#include <functional>
+
+class TiledCompositor
+{
+public:
+    struct Item {
+        QImage image;            // Ảnh gốc (chia sẻ ngầm, không sao chép)
+        QRect targetRect;        // Vị trí trong ảnh ghép, độ phân giải gốc
+        bool cropToFill = false; // Phóng cho lấp đầy khung rồi cắt giữa thay vì kéo giãn
+    };
+    using ProgressCallback = std::function<void(int done, int total)>;
+
+    TiledCompositor(const QSize &size, const QList<Item> &items, const QColor &backgroundColor, int cornerRadius);
+
+    // Co giãn một ảnh về kích thước trong ảnh ghép (dùng chung với ViewPanel::processImage)
+    static QImage scaledItem(const QImage &image, const QSize &target, bool cropToFill);
+
+    QSize size() const;
+    // Mức nén zlib của PNG (0..9)
+    void setPngCompression(int level);
+    // Dựng một vùng của ảnh ghép (RGBA 8 bit, alpha thẳng: đúng thứ tự byte của PNG/TIFF)
+    QImage renderTile(const QRect &rect) const;
+
+    // PNG ghi theo dải hàng, nén deflate liên tục qua zlib
+    bool writePng(const QString &filePath, const std::atomic<bool> *cancel = nullptr,
+                  const ProgressCallback &progress = ProgressCallback()) const;
+    // TIFF dạng tile, mỗi tile nén deflate riêng; tự chuyển sang BigTIFF khi file có thể vượt 4 GB
+    bool writeTiledTiff(const QString &filePath, const std::atomic<bool> *cancel = nullptr,
+                        const ProgressCallback &progress = ProgressCallback()) const;
+
+    // Đỉnh bộ nhớ thường trú của tiến trình (byte) từ lúc khởi động; -1 nếu không đọc được
+    static qint64 peakResidentBytes();
+
+private:
+    // Ảnh đã co giãn của các item mà dải đang dựng chạm tới, theo chỉ số item
+    using ScaledCache = QHash<int, QImage>;
+
+    QImage renderTile(const QRect &rect, ScaledCache &cache) const;
+    // Bỏ ảnh đã co giãn của các item nằm hẳn phía trên top (các dải sau không còn cần)
+    void evictAbove(ScaledCache &cache, int top) const;
+
+    static const int kTileSize = 256;    // Cạnh tile TIFF (bội của 16)
+    static const int kPngBandRows = 32;  // Số hàng mỗi dải PNG
+
+    QSize m_size;
+    QList<Item> m_items;
+    QColor m_backgroundColor;
+    int m_cornerRadius;
+    int m_pngCompression = 6;
+};
+
+#endif // TILEDCOMPOSITOR_H
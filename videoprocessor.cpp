@@ -1,9 +1,124 @@
-// videoprocessor.cpp - Version 1.7 (Sửa lỗi Heap Corruption)
+// videoprocessor.cpp - Version 3.2 (Đếm cấp phát packet âm thanh)
+// Change-log:
+// - Version 3.2: packetFrameAllocations cộng cả AVPacket do hàng đợi của AudioDecoder cấp phát; trước đây
+//   chỉ là hằng 2 (m_packet, m_frame) nên không chứng minh được gì.
+// - Version 3.1: Log "Scrub decoder opened" (mỗi lần nhấn thanh thời gian, mỗi tác vụ ảnh thu nhỏ) chuyển
+//   sang lcPerf.
+// - Version 3.0:
+//   - kMicrosecondTimeBase chuyển sang avtime.h, dùng chung với AudioDecoder và VideoWorker.
+// - Version 2.9:
+//   - setConversionQuality: đường chuyển đổi chất lượng cao (SWS_LANCZOS | SWS_ACCURATE_RND, nội suy
+//     đủ chroma, hệ số màu BT.601/709 và dải màu theo frame), tùy chọn xuất RGBA64.
+// - Version 2.8:
+//   - Luồng âm thanh (và mọi luồng không dùng tới) được đặt AVDISCARD_ALL khi âm thanh tắt:
+//     tua, bước frame, kéo thanh thời gian hay phát khi tắt tiếng không còn đọc packet âm thanh.
+// - Version 2.7:
+//   - Không còn giải mã âm thanh trong đường đọc video: packet âm thanh được chuyển cho AudioDecoder
+//     (chỉ khi setAudioEnabled), FrameData không còn mang audioData.
+// - Version 2.6:
+//   - FrameData mang audioEndUs để bên phát âm thanh tính được vị trí âm thanh đang phát (đồng hồ A/V).
+// - Version 2.5:
+//   - Thêm setScrubMode/scrubTo: decoder phụ với skip_frame=NONKEY, skip_loop_filter=ALL và lowres
+//     (khi codec hỗ trợ) chỉ giải mã keyframe gần mốc nhất.
+// - Version 2.4:
+//   - seekToPts kiểm tra cờ abort_seek sau mỗi frame để bỏ lần tua đã lỗi thời.
+// - Version 2.3:
+//   - Thêm seekToPts/seekToFrame: so sánh pts nguyên theo time base thay vì micro giây đã làm tròn.
+//   - Các frame trước mốc cần tua không còn bị chuyển sang RGB.
+//   - FrameData mang số thứ tự frame (frameNumber).
+// - Version 2.2:
+//   - Khi đã có FrameIndex, seek nhắm thẳng vào keyframe gần nhất phía trước mốc cần tua.
+// - Version 2.1:
+//   - sws_scale có thể chuyển thẳng về kích thước hiển thị (setOutputSize) thay vì độ phân giải gốc.
+// - Version 2.0:
+//   - Xuất ảnh dạng Format_RGB32 (AV_PIX_FMT_RGB32): ảnh không có kênh alpha nên Qt
+//     không phải chuyển sang premultiplied (thêm một bản sao cả frame) khi co giãn/vẽ.
+// - Version 1.9:
+//   - AVPacket/AVFrame được cấp phát một lần và dùng lại cho mọi lần giải mã.
+//   - Ảnh lấy từ FramePool, âm thanh dùng lại bộ đệm resample và các khối QByteArray.
+//   - Thêm bộ đếm cấp phát (getAllocationStats) để kiểm chứng.
+// - Version 1.8:
+//   - Bật frame/slice threading cho decoder video, số luồng tự động theo số nhân CPU.
+//   - decodeNextFrame nhận frame bị trễ trong decoder và xả (drain) decoder khi hết file.
+// - Version 1.7: Sửa lỗi Heap Corruption.
 #include "videoprocessor.h"
+#include "avtime.h"
+#include "audiodecoder.h"
+#include "perflog.h"
 #include <QDebug>
+#include <QThread>
 
-VideoProcessor::VideoProcessor() : stop_processing(false) {}
-VideoProcessor::~VideoProcessor() { cleanup(); }
+VideoProcessor::VideoProcessor() : stop_processing(false)
+{
+    m_packet = av_packet_alloc();
+    m_frame = av_frame_alloc();
+    m_allocStats.packetFrameAllocations = 2;
+}
+
+VideoProcessor::~VideoProcessor()
+{
+    cleanup();
+    av_frame_free(&m_frame);
+    av_packet_free(&m_packet);
+}
+
+void VideoProcessor::setDecoderThreading(DecoderThreading mode, int threadCount)
+{
+    m_threadingMode = mode;
+    m_threadCount = qMax(0, threadCount);
+}
+
+void VideoProcessor::applyThreadingOptions(AVCodecContext *codecContext) const
+{
+    if (m_threadingMode == ThreadingOff) {
+        codecContext->thread_count = 1;
+        return;
+    }
+    // Giới hạn 16 luồng: nhiều hơn thì độ trễ frame threading tăng mà tốc độ gần như không đổi
+    int threads = m_threadCount > 0 ? m_threadCount : QThread::idealThreadCount();
+    codecContext->thread_count = qBound(1, threads, 16);
+    switch (m_threadingMode) {
+        case ThreadingFrame: codecContext->thread_type = FF_THREAD_FRAME; break;
+        case ThreadingSlice: codecContext->thread_type = FF_THREAD_SLICE; break;
+        default: codecContext->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE; break;
+    }
+}
+
+void VideoProcessor::setOutputSize(const QSize &size)
+{
+    m_outputWidth = size.isValid() ? size.width() : 0;
+    m_outputHeight = size.isValid() ? size.height() : 0;
+}
+
+void VideoProcessor::setConversionQuality(ConversionQuality quality)
+{
+    m_conversionQuality = quality;
+}
+
+void VideoProcessor::setFrameIndex(std::shared_ptr<const FrameIndex> index)
+{
+    QMutexLocker locker(&m_indexMutex);
+    m_frameIndex = std::move(index);
+}
+
+std::shared_ptr<const FrameIndex> VideoProcessor::frameIndex() const
+{
+    QMutexLocker locker(&m_indexMutex);
+    return m_frameIndex;
+}
+
+void VideoProcessor::setAudioDecoder(AudioDecoder *decoder)
+{
+    m_audioDecoder = decoder;
+}
+
+void VideoProcessor::setAudioEnabled(bool enabled)
+{
+    m_audioEnabled = enabled;
+    if (formatContext && audioStreamIndex >= 0) {
+        formatContext->streams[audioStreamIndex]->discard = enabled ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+    }
+}
 
 bool VideoProcessor::openFile(const QString &filePath)
 {
@@ -21,101 +136,266 @@ bool VideoProcessor::openFile(const QString &filePath)
         if (videoCodec) {
             videoCodecContext = avcodec_alloc_context3(videoCodec);
             if (videoCodecContext && avcodec_parameters_to_context(videoCodecContext, codecParameters) >= 0) {
+                applyThreadingOptions(videoCodecContext);
                 if (avcodec_open2(videoCodecContext, videoCodec, nullptr) < 0) { cleanup(); return false; }
             } else { cleanup(); return false; }
         } else { cleanup(); return false; }
     } else { cleanup(); return false; }
 
     // --- Audio Stream ---
-    audioStreamIndex = av_find_best_stream(formatContext, AVMEDIA_TYPE_AUDIO, -1, videoStreamIndex, &audioCodec, 0);
-    if (audioStreamIndex >= 0) {
-        const AVCodecParameters *codecParameters = formatContext->streams[audioStreamIndex]->codecpar;
-        audioCodec = avcodec_find_decoder(codecParameters->codec_id);
-        if (audioCodec) {
-            audioCodecContext = avcodec_alloc_context3(audioCodec);
-            if (audioCodecContext && avcodec_parameters_to_context(audioCodecContext, codecParameters) >= 0) {
-                if (avcodec_open2(audioCodecContext, audioCodec, nullptr) < 0) { audioStreamIndex = -1; }
-                else {
-                    swrContext = swr_alloc();
-                    av_opt_set_chlayout(swrContext, "in_chlayout", &audioCodecContext->ch_layout, 0);
-                    av_opt_set_int(swrContext, "in_sample_rate", audioCodecContext->sample_rate, 0);
-                    av_opt_set_sample_fmt(swrContext, "in_sample_fmt", audioCodecContext->sample_fmt, 0);
-
-                    AVChannelLayout out_ch_layout;
-                    av_channel_layout_default(&out_ch_layout, 2);
-                    av_opt_set_chlayout(swrContext, "out_chlayout", &out_ch_layout, 0);
-                    av_opt_set_int(swrContext, "out_sample_rate", 44100, 0);
-                    av_opt_set_sample_fmt(swrContext, "out_sample_fmt", AV_SAMPLE_FMT_S16, 0);
-                    swr_init(swrContext);
-
-                    m_audioParams = {true, 44100, 2};
-                }
-            } else { audioStreamIndex = -1; }
-        } else { audioStreamIndex = -1; }
+    if (m_audioDecoder) {
+        audioStreamIndex = av_find_best_stream(formatContext, AVMEDIA_TYPE_AUDIO, -1, videoStreamIndex, nullptr, 0);
+        if (audioStreamIndex >= 0) {
+            AVStream *audioStream = formatContext->streams[audioStreamIndex];
+            if (m_audioDecoder->open(audioStream->codecpar, audioStream->time_base)) {
+                m_audioParams = {true, AudioDecoder::kSampleRate, AudioDecoder::kChannels};
+            } else {
+                audioStreamIndex = -1;
+            }
+        }
+    }
+    // Demuxer chỉ trả packet của luồng video (và luồng âm thanh khi đang bật)
+    for (unsigned int i = 0; i < formatContext->nb_streams; ++i) {
+        if (static_cast<int>(i) != videoStreamIndex) formatContext->streams[i]->discard = AVDISCARD_ALL;
     }
+    setAudioEnabled(m_audioEnabled);
     
-    qDebug() << "Successfully opened video file:" << filePath;
+    qDebug() << "Successfully opened video file:" << filePath
+             << "- decoder threads:" << videoCodecContext->thread_count
+             << "type:" << videoCodecContext->active_thread_type;
     return true;
 }
 
+static int64_t framePts(const AVFrame *frame)
+{
+    return frame->pts != AV_NOPTS_VALUE ? frame->pts : frame->best_effort_timestamp;
+}
+
 FrameData VideoProcessor::decodeNextFrame()
 {
     if (!formatContext) return {};
-    AVPacket* packet = av_packet_alloc();
-    AVFrame* frame = av_frame_alloc();
-    FrameData result;
+    while (receiveVideoFrame()) {
+        FrameData result = takeVideoFrame();
+        if (!result.image.isNull()) return result;
+    }
+    return {};
+}
+
+// Giải mã tới frame video kế tiếp và để nó trong m_frame (chưa chuyển đổi).
+// Packet âm thanh đọc được trên đường đi được chuyển cho AudioDecoder.
+bool VideoProcessor::receiveVideoFrame()
+{
+    AVPacket* packet = m_packet;
+    AVFrame* frame = m_frame;
+
+    while (!stop_processing) {
+        // Với frame threading, decoder trả frame trễ vài packet: luôn lấy frame đang chờ trước
+        int ret = avcodec_receive_frame(videoCodecContext, frame);
+        if (ret == 0) return true;
+        if (ret != AVERROR(EAGAIN)) break; // AVERROR_EOF: decoder đã xả hết
+
+        if (av_read_frame(formatContext, packet) < 0) {
+            // Hết file: gửi packet rỗng để xả các frame còn giữ trong các luồng giải mã
+            avcodec_send_packet(videoCodecContext, nullptr);
+            continue;
+        }
 
-    while (av_read_frame(formatContext, packet) >= 0 && !stop_processing) {
         if (packet->stream_index == videoStreamIndex) {
-            if (avcodec_send_packet(videoCodecContext, packet) == 0) {
-                if (avcodec_receive_frame(videoCodecContext, frame) == 0) {
-                    result.image = convertFrameToImage(frame);
-                    result.pts = frame->pts;
-                }
-            }
-        } else if (packet->stream_index == audioStreamIndex) {
-            if (avcodec_send_packet(audioCodecContext, packet) == 0) {
-                if (avcodec_receive_frame(audioCodecContext, frame) == 0) {
-                    result.audioData.append(resampleAudioFrame(frame));
-                }
-            }
+            avcodec_send_packet(videoCodecContext, packet);
+        } else if (packet->stream_index == audioStreamIndex && m_audioEnabled) {
+            m_audioDecoder->pushPacket(packet); // Lấy luôn dữ liệu, packet trở thành rỗng
         }
         av_packet_unref(packet);
-        
-        if(!result.image.isNull()) {
-            av_frame_free(&frame);
-            av_packet_free(&packet);
-            return result;
-        }
     }
 
-    av_frame_free(&frame);
-    av_packet_free(&packet);
-    return {};
+    av_packet_unref(packet);
+    return false;
+}
+
+FrameData VideoProcessor::takeVideoFrame()
+{
+    FrameData result;
+    result.image = convertFrameToImage(m_frame);
+    result.pts = framePts(m_frame);
+    result.frameNumber = frameNumberForPts(result.pts);
+    result.sourceSize = QSize(m_frame->width, m_frame->height);
+    av_frame_unref(m_frame);
+    if (result.image.isNull() || stop_processing) return {};
+    m_allocStats.framesDecoded++;
+    return result;
 }
 
 FrameData VideoProcessor::seekAndDecode(int64_t target_ts_us)
 {
-    if (!seek(target_ts_us)) return {};
-    FrameData frameData;
-    while (!stop_processing) {
-        frameData = decodeNextFrame();
-        if (frameData.image.isNull()) return frameData;
-        AVRational timeBase = getTimeBase();
-        if (timeBase.den == 0) return {};
-        int64_t current_ts_us = frameData.pts * 1000000 * timeBase.num / timeBase.den;
-        if (current_ts_us >= target_ts_us) return frameData;
+    if (!formatContext) return {};
+    AVRational timeBase = getTimeBase();
+    if (timeBase.den == 0) return {};
+    return seekToPts(av_rescale_q(target_ts_us, kMicrosecondTimeBase, timeBase));
+}
+
+FrameData VideoProcessor::seekToPts(int64_t targetPts)
+{
+    if (!formatContext || !seek(targetPts)) return {};
+    while (!abort_seek && receiveVideoFrame()) {
+        if (framePts(m_frame) >= targetPts) {
+            FrameData result = takeVideoFrame();
+            if (!result.image.isNull()) return result;
+            continue;
+        }
+        // Frame trước mốc cần tua: bỏ luôn, không chuyển sang RGB
+        av_frame_unref(m_frame);
     }
-    return {}; 
+    return {};
 }
 
-bool VideoProcessor::seek(int64_t timestamp)
+FrameData VideoProcessor::seekToFrame(int frameNumber)
+{
+    if (!formatContext) return {};
+    frameNumber = qMax(0, frameNumber);
+    if (std::shared_ptr<const FrameIndex> index = frameIndex()) {
+        return seekToPts(index->ptsAt(frameNumber));
+    }
+    // Chưa có chỉ mục: suy ra pts từ tốc độ khung hình trung bình (chỉ đúng với CFR)
+    AVRational frameRate = formatContext->streams[videoStreamIndex]->avg_frame_rate;
+    if (frameRate.num <= 0 || frameRate.den <= 0) return {};
+    return seekToPts(streamStartPts() + av_rescale_q(frameNumber, av_inv_q(frameRate), getTimeBase()));
+}
+
+int VideoProcessor::frameNumberForPts(int64_t pts) const
+{
+    if (!formatContext || pts == AV_NOPTS_VALUE) return -1;
+    if (std::shared_ptr<const FrameIndex> index = frameIndex()) {
+        return qMax(0, index->frameNumberForPts(pts));
+    }
+    AVRational frameRate = formatContext->streams[videoStreamIndex]->avg_frame_rate;
+    if (frameRate.num <= 0 || frameRate.den <= 0) return -1;
+    return static_cast<int>(qMax<int64_t>(0, av_rescale_q(pts - streamStartPts(), getTimeBase(), av_inv_q(frameRate))));
+}
+
+int VideoProcessor::getFrameCount() const
+{
+    if (std::shared_ptr<const FrameIndex> index = frameIndex()) return index->frameCount();
+    if (!formatContext || videoStreamIndex < 0) return 0;
+    AVStream *stream = formatContext->streams[videoStreamIndex];
+    if (stream->nb_frames > 0) return static_cast<int>(stream->nb_frames);
+    AVRational frameRate = stream->avg_frame_rate;
+    if (frameRate.num <= 0 || frameRate.den <= 0 || formatContext->duration <= 0) return 0;
+    return static_cast<int>(av_rescale_q(formatContext->duration, kMicrosecondTimeBase, av_inv_q(frameRate)));
+}
+
+void VideoProcessor::setScrubMode(bool enabled)
+{
+    closeScrubDecoder();
+    if (enabled && formatContext) openScrubDecoder();
+}
+
+bool VideoProcessor::openScrubDecoder()
+{
+    const AVCodecParameters *codecParameters = formatContext->streams[videoStreamIndex]->codecpar;
+    m_scrubCodecContext = avcodec_alloc_context3(videoCodec);
+    if (!m_scrubCodecContext || avcodec_parameters_to_context(m_scrubCodecContext, codecParameters) < 0) {
+        closeScrubDecoder();
+        return false;
+    }
+    // Chỉ giải mã keyframe và bỏ bộ lọc khử khối: đủ để xem trước khi kéo
+    m_scrubCodecContext->skip_frame = AVDISCARD_NONKEY;
+    m_scrubCodecContext->skip_loop_filter = AVDISCARD_ALL;
+    m_scrubCodecContext->flags2 |= AV_CODEC_FLAG2_FAST;
+    // Giảm độ phân giải ngay trong decoder (1/2, 1/4, 1/8) nếu codec hỗ trợ và vẫn không nhỏ hơn vùng hiển thị
+    int lowres = 0;
+    const int outputWidth = m_outputWidth;
+    if (outputWidth > 0) {
+        while (lowres < videoCodec->max_lowres && (codecParameters->width >> (lowres + 1)) >= outputWidth) lowres++;
+    }
+    m_scrubCodecContext->lowres = lowres;
+    // Mỗi lần chỉ giải mã một frame: frame threading không giúp gì mà còn thêm độ trễ
+    applyThreadingOptions(m_scrubCodecContext);
+    m_scrubCodecContext->thread_type = FF_THREAD_SLICE;
+    if (avcodec_open2(m_scrubCodecContext, videoCodec, nullptr) < 0) {
+        closeScrubDecoder();
+        return false;
+    }
+    qCDebug(lcPerf) << "Scrub decoder opened: lowres" << lowres << "threads" << m_scrubCodecContext->thread_count;
+    return true;
+}
+
+void VideoProcessor::closeScrubDecoder()
+{
+    if (m_scrubCodecContext) avcodec_free_context(&m_scrubCodecContext);
+    m_scrubCodecContext = nullptr;
+}
+
+FrameData VideoProcessor::scrubTo(int64_t target_ts_us)
+{
+    if (!formatContext) return {};
+    if (!m_scrubCodecContext) return seekAndDecode(target_ts_us);
+    AVRational timeBase = getTimeBase();
+    if (timeBase.den == 0) return {};
+    const int64_t targetPts = av_rescale_q(target_ts_us, kMicrosecondTimeBase, timeBase);
+
+    // Có chỉ mục: chọn keyframe gần nhất ở cả hai phía
+    int64_t seekPts = targetPts;
+    if (std::shared_ptr<const FrameIndex> index = frameIndex()) {
+        int64_t before = index->keyframeAtOrBefore(targetPts);
+        int64_t after = index->keyframeAtOrAfter(targetPts);
+        if (before == AV_NOPTS_VALUE || (after != AV_NOPTS_VALUE && after - targetPts < targetPts - before)) {
+            seekPts = after;
+        } else {
+            seekPts = before;
+        }
+    }
+    if (av_seek_frame(formatContext, videoStreamIndex, seekPts, AVSEEK_FLAG_BACKWARD) < 0) return {};
+    avcodec_flush_buffers(m_scrubCodecContext);
+    // Vị trí đọc đã đổi: decoder chính cũng phải bỏ trạng thái cũ
+    avcodec_flush_buffers(videoCodecContext);
+    if (audioStreamIndex >= 0) m_audioDecoder->flush();
+
+    FrameData result;
+    while (!stop_processing && !abort_seek && av_read_frame(formatContext, m_packet) >= 0) {
+        if (m_packet->stream_index != videoStreamIndex || !(m_packet->flags & AV_PKT_FLAG_KEY)) {
+            av_packet_unref(m_packet);
+            continue;
+        }
+        int ret = avcodec_send_packet(m_scrubCodecContext, m_packet);
+        av_packet_unref(m_packet);
+        if (ret < 0) continue;
+        // Xả ngay để decoder trả frame mà không chờ thêm packet (độ trễ sắp xếp lại B-frame)
+        avcodec_send_packet(m_scrubCodecContext, nullptr);
+        ret = avcodec_receive_frame(m_scrubCodecContext, m_frame);
+        avcodec_flush_buffers(m_scrubCodecContext);
+        if (ret < 0) continue;
+
+        result.image = convertFrameToImage(m_frame);
+        result.pts = framePts(m_frame);
+        result.frameNumber = frameNumberForPts(result.pts);
+        // Kích thước gốc của luồng (frame lowres nhỏ hơn) để nơi nhận biết đây là bản thu nhỏ
+        result.sourceSize = QSize(videoCodecContext->width, videoCodecContext->height);
+        av_frame_unref(m_frame);
+        if (!result.image.isNull()) break;
+    }
+    av_packet_unref(m_packet);
+    if (stop_processing || abort_seek) return {};
+    return result;
+}
+
+int64_t VideoProcessor::streamStartPts() const
+{
+    int64_t startTime = formatContext->streams[videoStreamIndex]->start_time;
+    return startTime != AV_NOPTS_VALUE ? startTime : 0;
+}
+
+bool VideoProcessor::seek(int64_t targetPts)
 {
     if (!formatContext) return false;
-    int64_t seek_target = av_rescale(timestamp, formatContext->streams[videoStreamIndex]->time_base.den, formatContext->streams[videoStreamIndex]->time_base.num) / 1000000;
+    int64_t seek_target = targetPts;
+    // Biết trước bố cục GOP: tua thẳng tới keyframe gần nhất, không phụ thuộc chỉ mục của demuxer
+    if (std::shared_ptr<const FrameIndex> index = frameIndex()) {
+        int64_t keyframePts = index->keyframeAtOrBefore(seek_target);
+        if (keyframePts != AV_NOPTS_VALUE) seek_target = keyframePts;
+    }
     if (av_seek_frame(formatContext, videoStreamIndex, seek_target, AVSEEK_FLAG_BACKWARD) < 0) return false;
     avcodec_flush_buffers(videoCodecContext);
-    if(audioCodecContext) avcodec_flush_buffers(audioCodecContext);
+    if (audioStreamIndex >= 0) m_audioDecoder->flush();
     return true;
 }
 
@@ -123,54 +403,78 @@ int64_t VideoProcessor::getDuration() const { return formatContext ? formatConte
 AVRational VideoProcessor::getTimeBase() const { return (formatContext && videoStreamIndex >= 0) ? formatContext->streams[videoStreamIndex]->time_base : AVRational{0, 1}; }
 double VideoProcessor::getFrameRate() const { if (formatContext && videoStreamIndex >= 0) { AVRational fr = formatContext->streams[videoStreamIndex]->avg_frame_rate; return (double)fr.num / fr.den; } return 0.0; }
 VideoProcessor::AudioParams VideoProcessor::getAudioParams() const { return m_audioParams; }
+int VideoProcessor::getDecoderThreadCount() const { return videoCodecContext ? videoCodecContext->thread_count : 0; }
+
+VideoProcessor::AllocationStats VideoProcessor::getAllocationStats() const
+{
+    AllocationStats stats = m_allocStats;
+    stats.imageBufferAllocations = m_framePool.allocationCount();
+    if (m_audioDecoder) stats.packetFrameAllocations += m_audioDecoder->packetAllocations();
+    return stats;
+}
+
+// Ma trận màu và dải màu theo metadata của frame (mặc định của swscale luôn là BT.601 dải hẹp)
+static void applyColorDetails(SwsContext *context, const AVFrame *frame)
+{
+    int *invTable = nullptr, *table = nullptr;
+    int srcRange = 0, dstRange = 0, brightness = 0, contrast = 0, saturation = 0;
+    // Nguồn là RGB thì không có chi tiết màu để chỉnh
+    if (sws_getColorspaceDetails(context, &invTable, &srcRange, &table, &dstRange, &brightness, &contrast, &saturation) < 0) return;
+    int colorspace = frame->colorspace;
+    if (colorspace == AVCOL_SPC_UNSPECIFIED) {
+        colorspace = frame->height >= 720 ? AVCOL_SPC_BT709 : AVCOL_SPC_SMPTE170M;
+    }
+    srcRange = frame->color_range == AVCOL_RANGE_JPEG ? 1 : srcRange;
+    sws_setColorspaceDetails(context, sws_getCoefficients(colorspace), srcRange, table, 1, brightness, contrast, saturation);
+}
 
 QImage VideoProcessor::convertFrameToImage(AVFrame* frame)
 {
     if (!frame) return QImage();
-    // SỬA LỖI HEAP CORRUPTION: Chuyển sang định dạng BGRA/ARGB32 an toàn hơn
-    swsContext = sws_getCachedContext(swsContext, frame->width, frame->height, (AVPixelFormat)frame->format, frame->width, frame->height, AV_PIX_FMT_BGRA, SWS_BILINEAR, nullptr, nullptr, nullptr);
+    // Khi có kích thước hiển thị, thu nhỏ ngay trong sws_scale (cùng công thức với VideoWidget)
+    QSize dstSize(frame->width, frame->height);
+    QSize outputSize(m_outputWidth, m_outputHeight);
+    if (outputSize.width() > 0 && outputSize.height() > 0
+        && (outputSize.width() < dstSize.width() || outputSize.height() < dstSize.height())) {
+        dstSize = dstSize.scaled(outputSize, Qt::KeepAspectRatio).expandedTo(QSize(1, 1));
+    }
+
+    // SỬA LỖI HEAP CORRUPTION: Chuyển sang định dạng 32-bit (AV_PIX_FMT_RGB32 khớp QImage::Format_RGB32 theo endian)
+    AVPixelFormat dstFormat = AV_PIX_FMT_RGB32;
+    QImage::Format imageFormat = QImage::Format_RGB32;
+    int flags = SWS_BILINEAR;
+    const bool highQuality = m_conversionQuality != ConversionFast;
+    if (highQuality) {
+        flags = SWS_LANCZOS | SWS_ACCURATE_RND | SWS_FULL_CHR_H_INT | SWS_FULL_CHR_H_INP;
+        if (m_conversionQuality == ConversionHighQuality16) {
+            // AV_PIX_FMT_RGBA64 theo endian của máy, khớp QImage::Format_RGBA64
+            dstFormat = AV_PIX_FMT_RGBA64;
+            imageFormat = QImage::Format_RGBA64;
+        }
+    }
+    swsContext = sws_getCachedContext(swsContext, frame->width, frame->height, (AVPixelFormat)frame->format, dstSize.width(), dstSize.height(), dstFormat, flags, nullptr, nullptr, nullptr);
     if (!swsContext) return QImage();
+    if (highQuality) applyColorDetails(swsContext, frame);
     
-    QImage image(frame->width, frame->height, QImage::Format_ARGB32);
+    QImage image = m_framePool.acquireImage(dstSize.width(), dstSize.height(), imageFormat);
+    if (image.isNull()) return QImage();
     uint8_t* const data[] = { image.bits() };
     const int linesize[] = { static_cast<int>(image.bytesPerLine()) };
     sws_scale(swsContext, (const uint8_t* const*)frame->data, frame->linesize, 0, frame->height, data, linesize);
     return image;
 }
 
-QByteArray VideoProcessor::resampleAudioFrame(AVFrame *frame)
-{
-    if (!swrContext || !frame) return QByteArray();
-    
-    uint8_t **dst_data = nullptr;
-    int dst_linesize;
-    int dst_nb_samples = av_rescale_rnd(swr_get_delay(swrContext, frame->sample_rate) + frame->nb_samples, 44100, frame->sample_rate, AV_ROUND_UP);
-
-    av_samples_alloc_array_and_samples(&dst_data, &dst_linesize, 2, dst_nb_samples, AV_SAMPLE_FMT_S16, 0);
-
-    int out_samples = swr_convert(swrContext, dst_data, dst_nb_samples, (const uint8_t **)frame->extended_data, frame->nb_samples);
-    
-    QByteArray buffer;
-    if(out_samples > 0) {
-        // Kích thước buffer = số sample * số kênh * kích thước 1 sample
-        buffer = QByteArray(reinterpret_cast<char*>(dst_data[0]), out_samples * 2 * sizeof(int16_t));
-    }
-
-    if (dst_data) av_freep(&dst_data[0]);
-    av_freep(&dst_data);
-
-    return buffer;
-}
-
 void VideoProcessor::cleanup()
 {
     stop_processing = true; 
     if (swsContext) { sws_freeContext(swsContext); swsContext = nullptr; }
     if (videoCodecContext) { avcodec_free_context(&videoCodecContext); videoCodecContext = nullptr; }
-    if (swrContext) { swr_free(&swrContext); swrContext = nullptr; }
-    if (audioCodecContext) { avcodec_free_context(&audioCodecContext); audioCodecContext = nullptr; }
+    closeScrubDecoder();
+    if (m_audioDecoder) m_audioDecoder->close();
     if (formatContext) { avformat_close_input(&formatContext); formatContext = nullptr; }
     videoStreamIndex = -1; videoCodec = nullptr;
-    audioStreamIndex = -1; audioCodec = nullptr;
+    audioStreamIndex = -1;
     m_audioParams = {false, 0, 0};
+    m_framePool.trim();
+    setFrameIndex(nullptr);
 }
@@ -1,11 +1,18 @@
-// videoprocessor.h - Version 1.5
+// videoprocessor.h - Version 2.9 (Đếm cấp phát packet âm thanh)
 #ifndef VIDEOPROCESSOR_H
 #define VIDEOPROCESSOR_H
 
 #include <QString>
 #include <QImage>
 #include <QByteArray>
+#include <QSize>
+#include <QMutex>
 #include <atomic> // Thêm vào để sử dụng std::atomic
+#include <vector>
+#include "framepool.h"
+#include "frameindex.h"
+
+class AudioDecoder;
 
 extern "C" {
 #include <libavformat/avformat.h>
@@ -13,15 +20,15 @@ extern "C" {
 #include <libswscale/swscale.h>
 #include <libavutil/imgutils.h>
 #include <libavutil/time.h>
-#include <libswresample/swresample.h>
-#include <libavutil/opt.h>
-#include <libavutil/channel_layout.h>
 }
 
+// FrameData được truyền qua signal theo giá trị nhưng không sao chép điểm ảnh:
+// image là handle đếm tham chiếu tới bộ đệm của FramePool (Format_RGB32, chỉ đọc).
 struct FrameData {
     QImage image;
-    QByteArray audioData;
     int64_t pts = 0;
+    int frameNumber = -1; // Số thứ tự frame (theo FrameIndex nếu có, nếu không thì ước lượng theo fps)
+    QSize sourceSize; // Kích thước gốc của frame (image có thể nhỏ hơn khi chuyển theo kích thước hiển thị)
 };
 
 class VideoProcessor
@@ -33,26 +40,72 @@ public:
         int channels = 0;
     };
 
+    // Chế độ đa luồng cho decoder video (áp dụng ở lần openFile kế tiếp)
+    enum DecoderThreading { ThreadingAuto, ThreadingFrame, ThreadingSlice, ThreadingOff };
+    // Chất lượng chuyển YUV -> RGB: Fast cho hiển thị; HighQuality (Lanczos, làm tròn chính xác,
+    // đúng ma trận màu của luồng) cho chụp frame; HighQuality16 xuất RGBA 16 bit mỗi kênh
+    enum ConversionQuality { ConversionFast, ConversionHighQuality, ConversionHighQuality16 };
+
+    // Đếm số lần cấp phát bộ nhớ heap trong đường giải mã (phát ổn định phải giữ nguyên)
+    struct AllocationStats {
+        quint64 framesDecoded = 0;
+        // AVPacket/AVFrame của VideoProcessor và AVPacket của hàng đợi AudioDecoder
+        quint64 packetFrameAllocations = 0;
+        quint64 imageBufferAllocations = 0;
+    };
+
     VideoProcessor();
     ~VideoProcessor();
 
+    void setDecoderThreading(DecoderThreading mode, int threadCount = 0);
+    // Kích thước đích cho sws_scale (giữ tỉ lệ, không phóng to). QSize() = độ phân giải gốc.
+    void setOutputSize(const QSize &size);
+    void setConversionQuality(ConversionQuality quality);
+    // Chỉ mục frame dựng ở nền; có thể gán sau khi mở file (an toàn đa luồng)
+    void setFrameIndex(std::shared_ptr<const FrameIndex> index);
+    std::shared_ptr<const FrameIndex> frameIndex() const;
+    // Packet âm thanh được chuyển cho decoder này (mở ở openFile). nullptr = bỏ qua âm thanh.
+    void setAudioDecoder(AudioDecoder *decoder);
+    // Tắt thì packet âm thanh bị bỏ ngay ở demuxer (AVDISCARD_ALL). Mặc định tắt.
+    // Chỉ gọi khi không có luồng nào đang đọc packet.
+    void setAudioEnabled(bool enabled);
     bool openFile(const QString &filePath);
     FrameData decodeNextFrame();
     FrameData seekAndDecode(int64_t timestamp);
+    // Tua tới frame đầu tiên có pts >= targetPts (so sánh trực tiếp theo time base của luồng)
+    FrameData seekToPts(int64_t targetPts);
+    FrameData seekToFrame(int frameNumber);
+    // Chỉ tua tới keyframe gần nhất không sau targetPts; các frame sau đó lấy bằng decodeNextFrame
+    bool seek(int64_t targetPts);
+    // Chế độ kéo thanh thời gian: decoder phụ chỉ giải mã keyframe (bỏ loop filter, lowres nếu codec hỗ trợ).
+    // scrubTo trả về keyframe gần mốc nhất, không chính xác tới từng frame.
+    void setScrubMode(bool enabled);
+    FrameData scrubTo(int64_t timestamp);
+    int frameNumberForPts(int64_t pts) const;
+    // Tổng số frame: chính xác khi đã có FrameIndex, nếu không thì ước lượng từ thời lượng
+    int getFrameCount() const;
 
     int64_t getDuration() const;
     AVRational getTimeBase() const;
     double getFrameRate() const;
     AudioParams getAudioParams() const;
+    int getDecoderThreadCount() const;
+    AllocationStats getAllocationStats() const;
 
     // THÊM MỚI: Cờ điều khiển an toàn cho đa luồng
     std::atomic<bool> stop_processing;
+    // Đặt từ luồng khác để seekToPts/seekAndDecode đang chạy dừng ở frame kế tiếp và trả về frame rỗng
+    std::atomic<bool> abort_seek = false;
 
 private:
     void cleanup();
+    bool openScrubDecoder();
+    void closeScrubDecoder();
+    void applyThreadingOptions(AVCodecContext *codecContext) const;
     QImage convertFrameToImage(AVFrame* frame);
-    QByteArray resampleAudioFrame(AVFrame* frame);
-    bool seek(int64_t timestamp);
+    bool receiveVideoFrame();
+    FrameData takeVideoFrame();
+    int64_t streamStartPts() const;
 
     AVFormatContext *formatContext = nullptr;
     // Video
@@ -60,12 +113,26 @@ private:
     const AVCodec *videoCodec = nullptr;
     SwsContext *swsContext = nullptr;
     int videoStreamIndex = -1;
-    // Audio
-    AVCodecContext *audioCodecContext = nullptr;
-    const AVCodec *audioCodec = nullptr;
-    SwrContext *swrContext = nullptr;
+    AVCodecContext *m_scrubCodecContext = nullptr; // Chỉ tồn tại trong chế độ kéo thanh thời gian
+    // Audio: chỉ chọn luồng, việc giải mã do AudioDecoder đảm nhận
     int audioStreamIndex = -1;
     AudioParams m_audioParams;
+    AudioDecoder *m_audioDecoder = nullptr;
+    bool m_audioEnabled = false;
+    // Đa luồng
+    DecoderThreading m_threadingMode = ThreadingAuto;
+    ConversionQuality m_conversionQuality = ConversionFast;
+    int m_threadCount = 0; // 0 = tự động theo số nhân CPU
+    // Bộ đệm dùng lại giữa các lần giải mã
+    AVPacket *m_packet = nullptr;
+    AVFrame *m_frame = nullptr;
+    FramePool m_framePool;
+    AllocationStats m_allocStats;
+    // Kích thước đích, có thể được đổi từ luồng khác trong khi đang giải mã trước
+    std::atomic<int> m_outputWidth = 0;
+    std::atomic<int> m_outputHeight = 0;
+    mutable QMutex m_indexMutex;
+    std::shared_ptr<const FrameIndex> m_frameIndex;
 };
 
 #endif // VIDEOPROCESSOR_H
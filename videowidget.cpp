@@ -1,5 +1,19 @@
-// videowidget.cpp - Version 1.1
+// videowidget.cpp - Version 1.5 (Kích thước hiển thị theo điểm ảnh thiết bị)
+// Change-log:
+// - Version 1.5:
+//   - displaySizeChanged báo kích thước đã nhân devicePixelRatioF(), báo lại khi widget sang màn hình có
+//     tỉ lệ khác; trên màn hình HiDPI frame không còn bị giải mã nhỏ rồi phóng to khi vẽ.
+//   - Ảnh co giãn theo điểm ảnh thiết bị rồi vẽ vào khung logic tương ứng (1:1 điểm ảnh màn hình).
+// - Version 1.4:
+//   - Phát signal displaySizeChanged khi widget đổi kích thước.
+// - Version 1.3:
+//   - Giữ bản ảnh đã co giãn, chỉ tạo lại khi đổi frame, đổi kích thước hoặc đổi chế độ lọc.
+//   - Co giãn nhanh (FastTransformation) khi phát/tua, mượt (SmoothTransformation) khi dừng.
+// - Version 1.2:
+//   - m_image chỉ giữ handle tới frame của decoder (không sao chép).
+//   - paintEvent co giãn ngay khi vẽ thay vì tạo QImage scaled() trung gian.
 #include "videowidget.h"
+#include <QResizeEvent>
 
 VideoWidget::VideoWidget(QWidget *parent) : QWidget(parent)
 {
@@ -14,9 +28,50 @@ QImage VideoWidget::getCurrentImage() const
 void VideoWidget::setImage(const QImage &image)
 {
     m_image = image;
+    m_scaledImageValid = false;
     update();
 }
 
+void VideoWidget::setFastScaling(bool fast)
+{
+    if (m_fastScaling == fast) return;
+    m_fastScaling = fast;
+    // Chuyển sang dừng: vẽ lại frame hiện tại bằng bộ lọc mượt
+    if (!fast) {
+        m_scaledImageValid = false;
+        update();
+    }
+}
+
+void VideoWidget::resizeEvent(QResizeEvent *event)
+{
+    m_scaledImageValid = false;
+    QWidget::resizeEvent(event);
+    reportDisplaySize();
+}
+
+void VideoWidget::reportDisplaySize()
+{
+    const QSize deviceSize = size() * devicePixelRatioF();
+    if (deviceSize == m_reportedDisplaySize) return;
+    m_reportedDisplaySize = deviceSize;
+    emit displaySizeChanged(deviceSize);
+}
+
+void VideoWidget::updateScaledImage(const QSize &targetSize, qreal dpr)
+{
+    if (targetSize == m_image.size()) {
+        // Dùng chung dữ liệu với frame của decoder: đổi devicePixelRatio ở đây sẽ sao chép cả frame,
+        // paintEvent vẽ vào khung logic nên vẫn đúng 1:1 điểm ảnh thiết bị
+        m_scaledImage = m_image;
+    } else {
+        Qt::TransformationMode mode = m_fastScaling ? Qt::FastTransformation : Qt::SmoothTransformation;
+        m_scaledImage = m_image.scaled(targetSize, Qt::IgnoreAspectRatio, mode);
+        m_scaledImage.setDevicePixelRatio(dpr);
+    }
+    m_scaledImageValid = true;
+}
+
 void VideoWidget::paintEvent(QPaintEvent *event)
 {
     Q_UNUSED(event);
@@ -24,9 +79,18 @@ void VideoWidget::paintEvent(QPaintEvent *event)
         return;
     }
 
+    // Widget có thể đã sang màn hình có devicePixelRatio khác mà không đổi kích thước logic
+    reportDisplaySize();
+    const qreal dpr = devicePixelRatioF();
+    QSize targetSize = m_image.size().scaled(this->size() * dpr, Qt::KeepAspectRatio);
+    if (targetSize.isEmpty()) return;
+    if (!m_scaledImageValid || m_scaledImage.size() != targetSize) {
+        updateScaledImage(targetSize, dpr);
+    }
+
     QPainter painter(this);
-    QImage scaledImage = m_image.scaled(this->size(), Qt::KeepAspectRatio, Qt::SmoothTransformation);
-    int x = (this->width() - scaledImage.width()) / 2;
-    int y = (this->height() - scaledImage.height()) / 2;
-    painter.drawImage(x, y, scaledImage);
+    const QSizeF logicalSize = QSizeF(targetSize) / dpr;
+    painter.drawImage(QRectF(QPointF((this->width() - logicalSize.width()) / 2, (this->height() - logicalSize.height()) / 2),
+                             logicalSize),
+                      m_scaledImage);
 }
@@ -1,4 +1,4 @@
-// videowidget.h - Version 1.1
+// videowidget.h - Version 1.5 (Kích thước hiển thị theo điểm ảnh thiết bị)
 #ifndef VIDEOWIDGET_H
 #define VIDEOWIDGET_H
 
@@ -16,12 +16,29 @@ public:
 
 public slots:
     void setImage(const QImage &image);
+    // Khi phát/tua dùng co giãn nhanh, khi dừng dùng co giãn mượt
+    void setFastScaling(bool fast);
+
+signals:
+    // Kích thước vùng hiển thị theo điểm ảnh thiết bị (đã nhân devicePixelRatio), để decoder chuyển đổi
+    // thẳng về kích thước này khi phát
+    void displaySizeChanged(const QSize &size);
 
 protected:
     void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
 
 private:
+    void updateScaledImage(const QSize &targetSize, qreal dpr);
+    // Phát displaySizeChanged nếu kích thước thiết bị khác lần báo trước (đổi cỡ hoặc sang màn hình khác)
+    void reportDisplaySize();
+
     QImage m_image;
+    // Bản đã co giãn theo kích thước widget, chỉ tạo lại khi đổi frame hoặc đổi kích thước
+    QImage m_scaledImage;
+    bool m_scaledImageValid = false;
+    bool m_fastScaling = false;
+    QSize m_reportedDisplaySize;
 };
 
 #endif // VIDEOWIDGET_H
@@ -1,26 +1,166 @@
-// videoworker.cpp - Version 1.4 (Sửa lỗi tua video và giật)
+// videoworker.cpp - Version 4.4 (Giới hạn bộ nhớ GOP khi phát ngược)
+// Change-log:
+// - Version 4.4: reverseDecodeLoop chỉ giữ phần cuối GOP trong giới hạn của hàng đợi phát ngược (số frame
+//   và dung lượng). Phần đầu bị bỏ được giải mã lại từ keyframe ở vòng sau, nên GOP dài ở độ phân giải
+//   cao không còn giữ toàn bộ frame trong bộ nhớ.
+// - Version 4.3: Thêm setAudioOutputAvailable: khi AudioOutput không có sink, packet âm thanh bị bỏ ở
+//   demuxer như khi tắt tiếng, để luồng giải mã âm thanh không đầy bộ đệm rồi chặn.
+// - Version 4.2: Log "Burst capture:" chuyển sang lcPerf (tốc độ đã hiện cho người dùng qua burstFinished).
+// - Version 4.1: Thống kê độ trễ kéo thanh thời gian (in khi thả) chuyển sang lcPerf.
+// - Version 4.0:
+//   - lcPerf khai báo trong perflog.h để các file khác dùng chung.
+//   - Log "Capture:" (mỗi lần chụp) chuyển sang lcPerf.
+// - Version 3.9: Log "Reverse GOP" (mỗi GOP khi phát ngược) chuyển sang category framecapture.perf.
+// - Version 3.8: Log "Allocations in last" cũng chuyển sang category framecapture.perf.
+// - Version 3.7: Log "Decode speed" chuyển sang category framecapture.perf, tắt mặc định
+//   (bật bằng QT_LOGGING_RULES="framecapture.perf.debug=true").
+// - Version 3.6:
+//   - Phát ngược lên lịch từng frame theo khoảng cách pts tới frame đang hiển thị thay vì nhịp cố định
+//     1000 / fps (sai với video VFR và làm tròn xuống với fps không chia hết 1000).
+//   - Bỏ avOffsetUs()/droppedFrames() không dùng; số liệu đi qua playbackStatsChanged.
+// - Version 3.5: postSeek chỉ đặt abort_seek khi processPendingSeek đang tua. Trước đây cờ đặt từ luồng
+//   GUI có thể rơi vào seekToPts của resyncStream/refreshCurrentFrame/processSeekToFrame, làm các lần
+//   tua này trả về frame rỗng.
+// - Version 3.4: burstFrameSaved gửi kèm frame đã giải mã để thư viện không phải đọc lại file.
+// - Version 3.3: Bỏ currentFrameNumber (không nơi nào gọi; số frame đi kèm FrameData).
+// - Version 3.2:
+//   - Mở file mới và hủy worker đặt m_burstCancel trước khi chờ m_capturePool, không còn chặn đến khi
+//     chụp loạt chạy hết khoảng.
+//   - Tên file chụp loạt đánh số theo thứ tự ảnh trong lần chụp thay vì frameNumber (ước lượng theo
+//     fps khi chưa có chỉ mục / video VFR nên có thể trùng, ghi đè file và lặp item thư viện).
+// - Version 3.1:
+//   - Dùng kMicrosecondTimeBase (avtime.h) thay cho AVRational{1, 1000000} viết tại chỗ.
+// - Version 3.0:
+//   - Chụp loạt gửi ảnh vào EncodePipeline dùng chung (hàng đợi có giới hạn, số luồng và định dạng
+//     chỉnh được) thay vì tự giới hạn bằng semaphore trên QThreadPool chung.
+//   - stop() hủy lần chụp loạt đang chạy.
+// - Version 2.9:
+//   - Thêm chụp loạt (processBurstCapture): giải mã tuần tự một khoảng, mã hóa PNG song song với
+//     số ảnh chờ mã hóa có giới hạn, log tốc độ (frame/giây).
+// - Version 2.8:
+//   - processCapture chạy trên m_capturePool thay vì chặn luồng worker, với chất lượng chuyển đổi
+//     riêng (mặc định chất lượng cao) không phụ thuộc đường hiển thị.
+// - Version 2.7:
+//   - Âm thanh chỉ được bật ở demuxer khi phát xuôi và không tắt tiếng. Sau khi bước frame hoặc
+//     phát trong lúc tắt tiếng, lần phát có âm thanh kế tiếp tua lại về frame đang hiển thị.
+// - Version 2.6:
+//   - Sở hữu AudioDecoder + AudioRingBuffer; packet âm thanh chỉ được chuyển đi khi giải mã trước
+//     theo chiều xuôi. Frame bị bỏ không còn phải gộp âm thanh.
+// - Version 2.5:
+//   - Trình chiếu theo pts so với PlaybackClock (âm thanh nếu có, nếu không thì monotonic)
+//     thay vì timer cố định 1000/fps (mili giây nguyên). Frame trễ bị bỏ, âm thanh của nó được gộp
+//     vào frame kế tiếp. Báo độ lệch A/V và số frame bị bỏ.
+// - Version 2.4:
+//   - Trong lúc kéo, VideoProcessor chạy chế độ scrub (chỉ keyframe); khi thả thì tua chính xác
+//     tới mốc cuối cùng. Không khởi động lại giải mã trước cho tới khi thả.
+// - Version 2.3:
+//   - postSeek: các yêu cầu tua dồn dập được gộp lại, chỉ mốc mới nhất được giải mã; lần tua
+//     đang chạy bị hủy khi có mốc mới hơn. Log độ trễ kéo -> hiển thị khi thả thanh thời gian.
+// - Version 2.2:
+//   - Thêm processPlayReverse: luồng giải mã giải mã xuôi từng GOP một lần rồi đẩy vào hàng đợi
+//     theo thứ tự ngược; trong lúc GOP hiện tại được trình chiếu, GOP liền trước đã được giải mã.
+// - Version 2.1:
+//   - Lưu frame đã giải mã vào FrameCache (LRU theo pts). "Frame trước" lấy thẳng từ cache;
+//     khi trượt cache thì giải mã lại cả GOP một lần và lưu toàn bộ vào cache.
+// - Version 2.0:
+//   - Thêm processSeekToFrame và currentFrameNumber; giải mã lại/chụp frame hiện tại theo đúng pts.
+//   - "Frame trước" dùng chỉ mục frame để lùi đúng một frame (kể cả video VFR).
+// - Version 1.9:
+//   - Sau khi mở file, dựng (hoặc đọc cache) FrameIndex trên thread pool rồi gán cho các VideoProcessor.
+// - Version 1.8:
+//   - Khi phát/tua, decoder chuyển thẳng về kích thước hiển thị; khi dừng, frame hiện tại
+//     được giải mã lại ở độ phân giải gốc.
+//   - Thêm processCapture: chụp ở độ phân giải gốc bằng VideoProcessor riêng.
+// - Version 1.7:
+//   - Log số lần cấp phát bộ đệm trong mỗi chu kỳ đo tốc độ giải mã.
+// - Version 1.6:
+//   - Giải mã trước trên luồng riêng vào FrameQueue; timer trình chiếu chỉ lấy frame đã sẵn sàng.
+//   - Sửa lỗi nút "Frame kế tiếp" không hoạt động khi đang dừng.
+// - Version 1.5:
+//   - Thêm slot setDecoderThreading và log tốc độ giải mã (fps) khi phát.
+// - Version 1.4: Sửa lỗi tua video và giật.
 #include "videoworker.h"
+#include "avtime.h"
+#include "perflog.h"
 #include <QDebug>
+#include <QDir>
+#include <QSemaphore>
 #include <QThread>
+#include <QUuid>
+#include <QtConcurrent>
+#include <deque>
+
+namespace {
+// Hàng đợi phát ngược chứa được trọn một GOP thì GOP kế tiếp được giải mã song song; GOP đang giải mã
+// cũng không giữ quá giới hạn này (phần vượt được giải mã lại)
+const int kReverseQueueFrames = 600;
+// Không hủy lần tua đang chạy nếu đã lâu chưa hiển thị frame nào, để kéo liên tục vẫn thấy hình
+const qint64 kMaxScrubStarvationNs = 150ll * 1000 * 1000;
+// Frame sớm hơn đồng hồ trong phạm vi này vẫn được trình chiếu ngay (độ phân giải của timer là 1 ms)
+const qint64 kEarlyToleranceUs = 2000;
+const int kUnderrunRetryMs = 4;
+}
 
 VideoWorker::VideoWorker(QObject *parent) : QObject(parent)
 {
+    // Khoảng 3 giây PCM: đủ để luồng giải mã âm thanh chạy trước, sink không bao giờ thiếu dữ liệu
+    m_audioRing = std::make_shared<AudioRingBuffer>(3 * AudioDecoder::kBytesPerSecond, AudioDecoder::kBytesPerSecond);
+    m_audioDecoder = std::make_unique<AudioDecoder>(m_audioRing);
     m_processor = std::make_unique<VideoProcessor>();
+    m_processor->setAudioDecoder(m_audioDecoder.get());
+    m_clock = std::make_shared<PlaybackClock>();
     m_playbackTimer = new QTimer(this);
     // SỬA LỖI GIẬT: Chuyển sang timer chính xác hơn
     m_playbackTimer->setTimerType(Qt::PreciseTimer);
     connect(m_playbackTimer, &QTimer::timeout, this, &VideoWorker::onPlaybackTimerTimeout);
+
+    m_reverseQueue.setLimits(kReverseQueueFrames, 256ll * 1024 * 1024);
+    m_capturePool.setMaxThreadCount(1);
+    m_seekClock.start();
+    m_statsTimer.start();
+
+    m_indexWatcher = new QFutureWatcher<std::shared_ptr<const FrameIndex>>(this);
+    connect(m_indexWatcher, &QFutureWatcher<std::shared_ptr<const FrameIndex>>::finished, this, &VideoWorker::onFrameIndexReady);
 }
 
 VideoWorker::~VideoWorker()
 {
     m_playbackTimer->stop();
+    stopDecodeAhead();
+    cancelIndexing();
+    m_burstCancel = true;
+    m_capturePool.waitForDone();
+}
+
+std::shared_ptr<PlaybackClock> VideoWorker::playbackClock() const
+{
+    return m_clock;
+}
+
+std::shared_ptr<AudioRingBuffer> VideoWorker::audioRing() const
+{
+    return m_audioRing;
 }
 
 void VideoWorker::processOpenFile(const QString &filePath)
 {
     m_isPlaying = false;
     m_playbackTimer->stop();
+    stopDecodeAhead();
+    m_frameQueue.clear();
+    // Chụp loạt của file cũ: dừng ở frame kế tiếp thay vì giải mã hết khoảng
+    m_burstCancel = true;
+    m_capturePool.waitForDone();
+    m_captureProcessor.reset();
+    cancelIndexing();
+    m_filePath = filePath;
+    m_frameCache.clear();
+    m_lastDecodedPts = AV_NOPTS_VALUE;
+    m_streamPts = AV_NOPTS_VALUE;
+    m_clock->pause();
+    m_droppedFrames = 0;
+    m_avOffsetUs = 0;
+    applyOutputSize();
     bool success = m_processor->openFile(filePath);
     if (success) {
         VideoProcessor::AudioParams params = m_processor->getAudioParams();
@@ -28,11 +168,12 @@ void VideoWorker::processOpenFile(const QString &filePath)
         qint64 duration = m_processor->getDuration();
         AVRational timeBase = m_processor->getTimeBase();
         emit fileOpened(true, params, frameRate, duration, timeBase);
+        emit frameCountChanged(m_processor->getFrameCount());
+        startIndexing(filePath);
 
         FrameData firstFrame = m_processor->seekAndDecode(0);
         if(!firstFrame.image.isNull()) {
-            m_currentPts = firstFrame.pts;
-            emit frameReady(firstFrame);
+            presentSeekResult(firstFrame);
         }
     } else {
         emit fileOpened(false, {}, 0.0, 0, {0, 1});
@@ -42,50 +183,651 @@ void VideoWorker::processOpenFile(const QString &filePath)
 void VideoWorker::processSeek(qint64 timestamp)
 {
     m_isSeeking = true;
-    
+    // Các frame đã giải mã trước không còn đúng vị trí sau khi tua
+    stopDecodeAhead();
+    m_frameQueue.clear();
+
     FrameData frame = m_processor->seekAndDecode(timestamp);
     if (!frame.image.isNull()) {
-        m_currentPts = frame.pts;
-        emit frameReady(frame);
+        presentSeekResult(frame);
     }
 
+    if (m_isPlaying) startDecodeAhead();
+    m_isSeeking = false;
+}
+
+void VideoWorker::postSeek(qint64 timestamp)
+{
+    const qint64 now = m_seekClock.nsecsElapsed();
+    m_pendingSeekTarget = timestamp;
+    m_pendingSeekPostedNs = now;
+    m_seekGeneration++;
+    m_scrubRequests++;
+    if (now - m_lastSeekPresentedNs < kMaxScrubStarvationNs) {
+        QMutexLocker locker(&m_seekAbortMutex);
+        if (m_pendingSeekRunning) m_processor->abort_seek = true;
+    }
+    // Chỉ xếp một lời gọi vào hàng đợi sự kiện của worker, dù có bao nhiêu yêu cầu
+    if (!m_seekScheduled.exchange(true)) {
+        QMetaObject::invokeMethod(this, &VideoWorker::processPendingSeek, Qt::QueuedConnection);
+    }
+}
+
+void VideoWorker::processPendingSeek()
+{
+    m_seekScheduled = false;
+    if (m_seekGeneration == m_handledSeekGeneration) return;
+
+    m_isSeeking = true;
+    stopDecodeAhead();
+    m_frameQueue.clear();
+
+    while (true) {
+        // Xóa cờ hủy trước khi đọc mốc: yêu cầu đến sau đó sẽ hủy đúng lần tua này
+        {
+            QMutexLocker locker(&m_seekAbortMutex);
+            m_processor->abort_seek = false;
+            m_pendingSeekRunning = true;
+        }
+        const quint64 generation = m_seekGeneration;
+        if (generation == m_handledSeekGeneration) break;
+        const qint64 target = m_pendingSeekTarget;
+        const qint64 postedNs = m_pendingSeekPostedNs;
+
+        FrameData frame = m_isScrubbing ? m_processor->scrubTo(target) : m_processor->seekAndDecode(target);
+        if (frame.image.isNull() && m_processor->abort_seek) {
+            m_scrubStats.aborted++;
+            continue;
+        }
+        m_handledSeekGeneration = generation;
+        if (m_isScrubbing) {
+            m_lastScrubTarget = target;
+            m_hasScrubTarget = true;
+        }
+        if (!frame.image.isNull()) {
+            if (m_isScrubbing) {
+                // Keyframe xem trước: decoder chính không đứng ở vị trí này
+                m_streamPts = AV_NOPTS_VALUE;
+                presentFrame(frame);
+            } else {
+                presentSeekResult(frame);
+            }
+            const qint64 now = m_seekClock.nsecsElapsed();
+            const qint64 latency = now - postedNs;
+            m_lastSeekPresentedNs = now;
+            m_scrubStats.displayed++;
+            m_scrubStats.totalLatencyNs += latency;
+            m_scrubStats.maxLatencyNs = qMax(m_scrubStats.maxLatencyNs, latency);
+        }
+        // Có mốc mới hơn trong lúc giải mã: vòng lặp tiếp tục với mốc đó
+    }
+    {
+        QMutexLocker locker(&m_seekAbortMutex);
+        m_pendingSeekRunning = false;
+        m_processor->abort_seek = false;
+    }
+
+    // Khi đang kéo, phát lại chỉ tiếp tục sau khi thả (đã tua chính xác)
+    if (m_isPlaying && !m_isScrubbing) startDecodeAhead();
+    m_isSeeking = false;
+}
+
+void VideoWorker::processSeekToFrame(int frameNumber)
+{
+    m_isSeeking = true;
+    stopDecodeAhead();
+    m_frameQueue.clear();
+
+    FrameData frame = m_processor->seekToFrame(frameNumber);
+    if (!frame.image.isNull()) {
+        presentSeekResult(frame);
+    }
+
+    if (m_isPlaying) startDecodeAhead();
     m_isSeeking = false;
 }
 
 void VideoWorker::processPlayPause(bool play)
 {
+    // Đang phát ngược: dừng luồng giải mã ngược trước khi đổi chiều/dừng
+    if (m_playReverse) {
+        m_playbackTimer->stop();
+        stopDecodeAhead();
+        m_playReverse = false;
+    }
     m_isPlaying = play;
     if (m_isPlaying) {
         double frameRate = m_processor->getFrameRate();
         if (frameRate > 0) {
-            // Bắt đầu phát ngay lập tức
+            applyOutputSize();
+            // Đang đứng ở frame lấy từ cache: đưa decoder về đúng vị trí trước khi phát
+            if (m_streamPts != m_currentPts || (audioEnabled() && !m_audioInSync)) resyncStream();
+            startDecodeAhead();
+            // Frame đang hiển thị là mốc 0 của đồng hồ; frame kế tiếp được lên lịch theo pts
+            m_clock->start(ptsToUs(m_currentPts));
+            m_clockStalled = false;
             onPlaybackTimerTimeout();
         }
     } else {
         m_playbackTimer->stop();
+        m_clock->pause();
+        // Giữ lại các frame trong hàng đợi: chúng vẫn nối tiếp vị trí hiện tại
+        stopDecodeAhead();
+        applyOutputSize();
+        // Frame đang hiển thị là bản thu nhỏ: giải mã lại ở độ phân giải gốc
+        if (m_currentFrameScaled) refreshCurrentFrame();
     }
 }
 
+void VideoWorker::processPlayReverse(bool play)
+{
+    if (!play) {
+        processPlayPause(false);
+        return;
+    }
+    if (m_isPlaying && m_playReverse && m_decodeThread) return;
+    if (m_processor->getFrameRate() <= 0) return;
+
+    m_playbackTimer->stop();
+    stopDecodeAhead();
+    m_isPlaying = true;
+    m_playReverse = true;
+    m_reverseStalled = true;
+    applyOutputSize();
+    startDecodeAhead();
+    onPlaybackTimerTimeout();
+}
+
 void VideoWorker::processNextFrame()
 {
     if (m_isPlaying) return;
-    onPlaybackTimerTimeout();
+    FrameData frame;
+    if (m_streamPts != m_currentPts) {
+        // Vừa lùi bằng cache: tiến lại trong cache nếu còn, nếu không thì đưa decoder về vị trí hiện tại
+        if (m_frameCache.findNext(m_currentPts, frame) && frame.image.size() == frame.sourceSize) {
+            presentFrame(frame);
+            return;
+        }
+        resyncStream();
+    }
+    if (!m_frameQueue.tryPop(frame)) {
+        frame = decodeMeasured();
+    }
+    if (!frame.image.isNull()) {
+        presentStreamFrame(frame);
+        // Âm thanh đã giải mã trước (hoặc bị bỏ) không còn khớp với frame mới
+        m_audioInSync = false;
+    }
 }
 
 void VideoWorker::processPrevFrame()
 {
     if (m_isPlaying) return;
 
+    FrameData frame;
+    // Frame liền trước đã có ở độ phân giải gốc: không cần giải mã
+    if (!m_frameCache.findPrevious(m_currentPts, frame) || frame.image.size() != frame.sourceSize) {
+        frame = decodePreviousFrame();
+    }
+    if (!frame.image.isNull()) {
+        presentFrame(frame);
+    }
+}
+
+FrameData VideoWorker::decodePreviousFrame()
+{
+    // Giải mã lại từ keyframe trước đó tới frame hiện tại. Mọi frame trên đường đi đều vào cache
+    // nên các lần lùi tiếp theo trong cùng GOP được phục vụ từ bộ nhớ.
+    const int64_t targetPts = m_currentPts;
+    m_frameQueue.clear();
+    if (!m_processor->seek(targetPts - 1)) return {};
+    m_lastDecodedPts = AV_NOPTS_VALUE;
+
+    FrameData previous;
+    while (true) {
+        FrameData frame = decodeMeasured();
+        if (frame.image.isNull() || frame.pts >= targetPts) break;
+        previous = frame;
+    }
+    m_streamPts = m_lastDecodedPts;
+    return previous;
+}
+
+void VideoWorker::setDecoderThreading(VideoProcessor::DecoderThreading mode, int threadCount)
+{
+    // Có hiệu lực từ lần mở file kế tiếp
+    m_threadingMode = mode;
+    m_threadCount = threadCount;
+    m_processor->setDecoderThreading(mode, threadCount);
+}
+
+void VideoWorker::setFrameCacheLimit(qint64 maxBytes)
+{
+    m_frameCache.setMaxBytes(maxBytes);
+}
+
+void VideoWorker::setDisplaySize(const QSize &size)
+{
+    m_displaySize = size;
+    applyOutputSize();
+}
+
+void VideoWorker::setScrubbing(bool scrubbing)
+{
+    if (!scrubbing && m_isScrubbing) {
+        const ScrubStats &stats = m_scrubStats;
+        const int requests = m_scrubRequests.exchange(0);
+        if (stats.displayed > 0) {
+            qCDebug(lcPerf) << "Scrub:" << requests << "seek requests," << stats.displayed << "displayed,"
+                     << stats.aborted << "aborted, latency avg"
+                     << stats.totalLatencyNs / stats.displayed / 1e6 << "ms, max"
+                     << stats.maxLatencyNs / 1e6 << "ms";
+        }
+    }
+    if (scrubbing && !m_isScrubbing) {
+        m_scrubStats = ScrubStats();
+        m_scrubRequests = 0;
+        m_hasScrubTarget = false;
+    }
+    const bool wasScrubbing = m_isScrubbing;
+    m_isScrubbing = scrubbing;
+    applyOutputSize();
+    if (m_isScrubbing != wasScrubbing) m_processor->setScrubMode(m_isScrubbing);
+
+    if (!m_isScrubbing && m_hasScrubTarget) {
+        // Frame đang hiển thị chỉ là keyframe gần đó: tua chính xác tới mốc cuối cùng
+        m_hasScrubTarget = false;
+        stopDecodeAhead();
+        m_frameQueue.clear();
+        FrameData frame = m_processor->seekAndDecode(m_lastScrubTarget);
+        if (!frame.image.isNull()) {
+            presentSeekResult(frame);
+        }
+    } else if (!m_isScrubbing && !m_isPlaying && m_currentFrameScaled) {
+        refreshCurrentFrame();
+    }
+}
+
+void VideoWorker::setAudioMuted(bool muted)
+{
+    if (muted == m_audioMuted) return;
+    const bool wasEnabled = audioEnabled();
+    m_audioMuted = muted;
+    updateAudioEnabled(wasEnabled);
+}
+
+void VideoWorker::setAudioOutputAvailable(bool available)
+{
+    if (available == m_audioOutputAvailable) return;
+    const bool wasEnabled = audioEnabled();
+    m_audioOutputAvailable = available;
+    updateAudioEnabled(wasEnabled);
+}
+
+bool VideoWorker::audioEnabled() const
+{
+    return !m_audioMuted && m_audioOutputAvailable;
+}
+
+void VideoWorker::updateAudioEnabled(bool wasEnabled)
+{
+    if (audioEnabled() == wasEnabled) return;
+    if (!m_isPlaying || m_playReverse || !m_decodeThread) return;
+
+    // Đổi trạng thái bỏ packet ở demuxer phải làm khi luồng giải mã trước đã dừng
+    stopDecodeAhead();
+    if (audioEnabled()) resyncStream();
+    startDecodeAhead();
+}
+
+void VideoWorker::processCapture(bool exportImage)
+{
+    if (m_filePath.isEmpty()) return;
+    const QString filePath = m_filePath;
+    const int64_t pts = m_currentPts;
+    const VideoProcessor::ConversionQuality quality = m_captureQuality;
+    const VideoProcessor::DecoderThreading threadingMode = m_threadingMode;
+    const int threadCount = m_threadCount;
+    std::shared_ptr<const FrameIndex> index = m_processor->frameIndex();
+
+    m_capturePool.start([=]() {
+        QElapsedTimer timer;
+        timer.start();
+        // Dùng VideoProcessor riêng để không làm xáo trộn vị trí/bộ đệm của luồng phát
+        if (!m_captureProcessor) {
+            m_captureProcessor = std::make_unique<VideoProcessor>();
+            m_captureProcessor->setDecoderThreading(threadingMode, threadCount);
+            if (!m_captureProcessor->openFile(filePath)) {
+                m_captureProcessor.reset();
+                return;
+            }
+        }
+        if (index) m_captureProcessor->setFrameIndex(index);
+        m_captureProcessor->setConversionQuality(quality);
+        FrameData frame = m_captureProcessor->seekToPts(pts);
+        if (!frame.image.isNull()) {
+            qCDebug(lcPerf) << "Capture:" << frame.image.size() << frame.image.format() << "in" << timer.elapsed() << "ms";
+            emit captureReady(frame.image, exportImage);
+        }
+    });
+}
+
+void VideoWorker::setCaptureQuality(VideoProcessor::ConversionQuality quality)
+{
+    m_captureQuality = quality;
+}
+
+void VideoWorker::cancelBurstCapture()
+{
+    m_burstCancel = true;
+}
+
+void VideoWorker::setEncodePipeline(std::shared_ptr<EncodePipeline> pipeline)
+{
+    m_encodePipeline = std::move(pipeline);
+}
+
+void VideoWorker::processBurstCapture(qint64 startUs, qint64 endUs, int stride, const QString &outputDir)
+{
+    std::shared_ptr<EncodePipeline> pipeline = m_encodePipeline;
+    if (!pipeline || m_filePath.isEmpty() || endUs < startUs) {
+        emit burstFinished(0, 0.0);
+        return;
+    }
+    const QString filePath = m_filePath;
+    const VideoProcessor::ConversionQuality quality = m_captureQuality;
+    const VideoProcessor::DecoderThreading threadingMode = m_threadingMode;
+    const int threadCount = m_threadCount;
+    std::shared_ptr<const FrameIndex> index = m_processor->frameIndex();
+    const AVRational timeBase = m_processor->getTimeBase();
+    const double frameRate = m_processor->getFrameRate();
+    stride = qMax(1, stride);
+    m_burstCancel = false;
+
+    m_capturePool.start([=]() {
+        if (!m_captureProcessor) {
+            m_captureProcessor = std::make_unique<VideoProcessor>();
+            m_captureProcessor->setDecoderThreading(threadingMode, threadCount);
+            if (!m_captureProcessor->openFile(filePath)) {
+                m_captureProcessor.reset();
+                emit burstFinished(0, 0.0);
+                return;
+            }
+        }
+        if (index) m_captureProcessor->setFrameIndex(index);
+        m_captureProcessor->setConversionQuality(quality);
+
+        const int64_t endPts = av_rescale_q(endUs, kMicrosecondTimeBase, timeBase);
+        int total = 0;
+        if (index) {
+            const int64_t startPts = av_rescale_q(startUs, kMicrosecondTimeBase, timeBase);
+            total = index->frameNumberForPts(endPts) - qMax(0, index->frameNumberForPts(startPts - 1) + 1) + 1;
+        } else {
+            total = static_cast<int>((endUs - startUs) * frameRate / 1e6) + 1;
+        }
+        total = qMax(1, (total + stride - 1) / stride);
+
+        // Mỗi ảnh đã gửi nhả một lần khi ghi xong (thành công hay không)
+        QSemaphore encodedJobs;
+        int submitted = 0;
+        std::atomic<int> saved = 0;
+        const QString burstId = QUuid::createUuid().toString(QUuid::Id128).left(8);
+        QElapsedTimer timer;
+        timer.start();
+
+        int position = 0;
+        FrameData frame = m_captureProcessor->seekAndDecode(startUs);
+        while (!frame.image.isNull() && frame.pts <= endPts && !m_burstCancel) {
+            if (position++ % stride == 0) {
+                // Đánh số theo thứ tự ảnh đã gửi: frameNumber có thể trùng khi chỉ là ước lượng theo fps
+                const QString baseName = QString("burst_%1_%2").arg(burstId).arg(submitted, 6, 10, QChar('0'));
+                // Chặn khi hàng đợi mã hóa đầy: giải mã không chạy xa hơn tốc độ ghi
+                const QImage image = frame.image;
+                const bool accepted = pipeline->submit(image, QDir(outputDir).filePath(baseName),
+                    [this, image, total, &encodedJobs, &saved](bool ok, const QString &filePath) {
+                        if (ok) {
+                            emit burstFrameSaved(filePath, image);
+                            emit burstProgress(++saved, total);
+                        }
+                        encodedJobs.release();
+                    }, &m_burstCancel);
+                if (!accepted) break;
+                submitted++;
+            }
+            frame = m_captureProcessor->decodeNextFrame();
+        }
+        // Chờ mọi ảnh đã gửi ghi xong (encodedJobs và saved nằm trên stack của tác vụ này)
+        encodedJobs.acquire(submitted);
+
+        const double seconds = timer.nsecsElapsed() / 1e9;
+        const double fps = seconds > 0 ? saved / seconds : 0.0;
+        qCDebug(lcPerf) << "Burst capture:" << saved.load() << "frames in" << seconds << "s ->" << fps << "fps"
+                 << (m_burstCancel ? "(cancelled)" : "");
+        emit burstFinished(saved, fps);
+    });
+}
+
+void VideoWorker::startIndexing(const QString &filePath)
+{
+    m_indexCancel = std::make_shared<std::atomic<bool>>(false);
+    m_indexPath = filePath;
+    std::shared_ptr<std::atomic<bool>> cancel = m_indexCancel;
+    m_indexWatcher->setFuture(QtConcurrent::run([filePath, cancel]() {
+        return FrameIndex::loadOrBuild(filePath, *cancel);
+    }));
+}
+
+void VideoWorker::cancelIndexing()
+{
+    if (m_indexCancel) *m_indexCancel = true;
+    m_indexCancel.reset();
+    m_indexPath.clear();
+}
+
+void VideoWorker::onFrameIndexReady()
+{
+    // Kết quả của file cũ (đã mở file khác hoặc đã hủy) thì bỏ qua
+    if (m_indexPath.isEmpty() || m_indexPath != m_filePath) return;
+    std::shared_ptr<const FrameIndex> index = m_indexWatcher->result();
+    if (!index) return;
+    m_processor->setFrameIndex(index);
+    emit frameCountChanged(index->frameCount());
+}
+
+void VideoWorker::presentFrame(const FrameData &frame)
+{
+    m_currentPts = frame.pts;
+    m_currentFrameScaled = frame.image.size() != frame.sourceSize;
+    emit frameReady(frame);
+}
+
+void VideoWorker::presentStreamFrame(const FrameData &frame)
+{
+    m_streamPts = frame.pts;
+    presentFrame(frame);
+}
+
+void VideoWorker::presentSeekResult(const FrameData &frame)
+{
+    m_frameCache.insert(frame, AV_NOPTS_VALUE);
+    m_lastDecodedPts = frame.pts;
+    m_audioInSync = true;
+    presentStreamFrame(frame);
+    // Đang phát: đồng hồ tiếp tục từ vị trí mới
+    if (m_isPlaying && !m_playReverse) {
+        m_clock->start(ptsToUs(frame.pts));
+    }
+}
+
+qint64 VideoWorker::ptsToUs(int64_t pts) const
+{
     AVRational timeBase = m_processor->getTimeBase();
-    if (timeBase.den == 0) return;
-    double frameRate = m_processor->getFrameRate();
-    if(frameRate == 0.0) return;
+    if (timeBase.den == 0) return 0;
+    return av_rescale_q(pts, timeBase, kMicrosecondTimeBase);
+}
+
+void VideoWorker::resyncStream()
+{
+    // Giải mã lại frame đang hiển thị để decoder đứng ngay sau nó
+    m_frameQueue.clear();
+    FrameData frame = m_processor->seekToPts(m_currentPts);
+    if (!frame.image.isNull()) {
+        m_frameCache.insert(frame, AV_NOPTS_VALUE);
+        m_lastDecodedPts = frame.pts;
+    }
+    m_streamPts = m_currentPts;
+    m_audioInSync = true;
+}
+
+void VideoWorker::applyOutputSize()
+{
+    m_processor->setOutputSize((m_isPlaying || m_isScrubbing) ? m_displaySize : QSize());
+}
+
+void VideoWorker::refreshCurrentFrame()
+{
+    m_frameQueue.clear();
+    FrameData frame = m_processor->seekToPts(m_currentPts);
+    if (!frame.image.isNull()) {
+        presentSeekResult(frame);
+    }
+}
+
+void VideoWorker::setDecodeAheadLimits(int maxFrames, qint64 maxBytes)
+{
+    m_frameQueue.setLimits(maxFrames, maxBytes);
+    m_reverseQueue.setLimits(kReverseQueueFrames, maxBytes);
+}
+
+void VideoWorker::startDecodeAhead()
+{
+    if (m_decodeThread) return;
+    m_frameQueue.reset();
+    m_reverseQueue.reset();
+    m_decodeAheadEof = false;
+    m_decodeAheadRunning = true;
+    if (m_playReverse) {
+        // Decoder sẽ rời khỏi vị trí hiện tại: các frame xuôi đã giải mã trước không còn dùng được
+        m_frameQueue.clear();
+        m_streamPts = AV_NOPTS_VALUE;
+        const int64_t endPts = m_currentPts;
+        m_decodeThread.reset(QThread::create([this, endPts]() { reverseDecodeLoop(endPts); }));
+        m_decodeThread->setObjectName("ReverseDecode");
+    } else {
+        m_processor->setAudioEnabled(audioEnabled());
+        emit audioActiveChanged(audioEnabled());
+        if (!audioEnabled()) m_audioInSync = false;
+        m_decodeThread.reset(QThread::create([this]() { decodeAheadLoop(); }));
+        m_decodeThread->setObjectName("DecodeAhead");
+    }
+    m_decodeThread->start();
+}
+
+void VideoWorker::stopDecodeAhead()
+{
+    if (!m_decodeThread) return;
+    m_decodeAheadRunning = false;
+    m_frameQueue.abort();
+    m_reverseQueue.abort();
+    m_decodeThread->wait();
+    m_decodeThread.reset();
+    m_processor->setAudioEnabled(false);
+    emit audioActiveChanged(false);
+    m_frameQueue.reset();
+    m_reverseQueue.reset();
+    // Phát lại ngược luôn bắt đầu lại từ frame đang hiển thị
+    m_reverseQueue.clear();
 
-    qint64 currentTimeUs = m_currentPts * 1000000 * timeBase.num / timeBase.den;
-    double frameDurationUs = 1000000.0 / frameRate;
-    qint64 prevTimeUs = qMax((qint64)0, currentTimeUs - (long long)(1.5 * frameDurationUs));
-    
-    processSeek(prevTimeUs);
+    // Frame đã giải mã nhưng chưa kịp vào hàng đợi vẫn phải được trình chiếu tiếp theo
+    if (!m_carryFrame.image.isNull()) {
+        m_frameQueue.pushUnbounded(m_carryFrame);
+        m_carryFrame = FrameData();
+    }
+}
+
+void VideoWorker::decodeAheadLoop()
+{
+    while (m_decodeAheadRunning) {
+        FrameData frame = decodeMeasured();
+        if (frame.image.isNull()) {
+            m_decodeAheadEof = true;
+            break;
+        }
+        if (!m_frameQueue.push(frame)) {
+            m_carryFrame = frame;
+            break;
+        }
+    }
+}
+
+void VideoWorker::reverseDecodeLoop(int64_t endPts)
+{
+    std::deque<FrameData> gop;
+    QElapsedTimer gopTimer;
+    while (m_decodeAheadRunning) {
+        // GOP chứa frame liền trước endPts: tua về keyframe của nó rồi giải mã xuôi tới endPts
+        gopTimer.start();
+        gop.clear();
+        qint64 gopBytes = 0;
+        bool truncated = false;
+        const qint64 maxBytes = m_reverseQueue.maxBytes();
+        if (!m_processor->seek(endPts - 1)) {
+            m_decodeAheadEof = true;
+            return;
+        }
+        m_lastDecodedPts = AV_NOPTS_VALUE;
+        while (m_decodeAheadRunning) {
+            FrameData frame = decodeMeasured();
+            if (frame.image.isNull() || frame.pts >= endPts) break;
+            gopBytes += FrameQueue::frameBytes(frame);
+            gop.push_back(frame);
+            // Chỉ giữ các frame gần endPts nhất (được phát trước); phần đầu GOP giải mã lại ở vòng sau
+            while (gop.size() > 1 && (gopBytes > maxBytes || int(gop.size()) > kReverseQueueFrames)) {
+                gopBytes -= FrameQueue::frameBytes(gop.front());
+                gop.pop_front();
+                truncated = true;
+            }
+        }
+        if (!m_decodeAheadRunning) return;
+        if (gop.empty()) {
+            m_decodeAheadEof = true; // Đã tới đầu file
+            return;
+        }
+        qCDebug(lcPerf) << "Reverse GOP:" << gop.size() << "frames" << (truncated ? "(partial)" : "")
+                        << "decoded in" << gopTimer.elapsed() << "ms";
+
+        endPts = gop.front().pts;
+        for (auto it = gop.rbegin(); it != gop.rend(); ++it) {
+            if (!m_reverseQueue.push(*it)) return;
+        }
+    }
+}
+
+FrameData VideoWorker::decodeMeasured()
+{
+    m_decodeTimer.start();
+    FrameData frame = m_processor->decodeNextFrame();
+    m_decodeNsAccum += m_decodeTimer.nsecsElapsed();
+    if (!frame.image.isNull()) {
+        m_frameCache.insert(frame, m_lastDecodedPts);
+        m_lastDecodedPts = frame.pts;
+    }
+    if (++m_decodeFrameCount >= 120) {
+        double seconds = m_decodeNsAccum / 1e9;
+        if (seconds > 0) {
+            qCDebug(lcPerf) << "Decode speed:" << m_decodeFrameCount / seconds << "fps with"
+                     << m_processor->getDecoderThreadCount() << "decoder thread(s)";
+        }
+        // Khi phát ổn định, các số đếm này phải bằng 0
+        VideoProcessor::AllocationStats stats = m_processor->getAllocationStats();
+        qCDebug(lcPerf) << "Allocations in last" << m_decodeFrameCount << "frames: image"
+                 << stats.imageBufferAllocations - m_lastAllocStats.imageBufferAllocations
+                 << "packet/frame" << stats.packetFrameAllocations - m_lastAllocStats.packetFrameAllocations;
+        m_lastAllocStats = stats;
+        m_decodeNsAccum = 0;
+        m_decodeFrameCount = 0;
+    }
+    return frame;
 }
 
 void VideoWorker::stop()
@@ -95,27 +837,119 @@ void VideoWorker::stop()
     if (m_processor) {
         m_processor->stop_processing = true;
     }
+    m_burstCancel = true;
+    stopDecodeAhead();
+    m_frameQueue.clear();
+    cancelIndexing();
     emit finished();
 }
 
 void VideoWorker::onPlaybackTimerTimeout()
 {
     if (m_isSeeking || !m_isPlaying) return;
+    if (m_playReverse) {
+        presentNextReverseFrame();
+        return;
+    }
 
-    FrameData frame = m_processor->decodeNextFrame();
-    if (!frame.image.isNull()) {
-        m_currentPts = frame.pts;
-        emit frameReady(frame);
-
-        // Lên lịch cho frame tiếp theo
-        if (m_isPlaying) {
-            double frameRate = m_processor->getFrameRate();
-            if (frameRate > 0) {
-                m_playbackTimer->start(1000 / frameRate);
-            }
+    FrameData frame;
+    if (!m_frameQueue.tryPeek(frame)) {
+        if (m_decodeAheadEof) {
+            finishPlayback();
+            return;
         }
+        // Luồng giải mã chưa kịp: không có âm thanh dẫn nhịp thì dừng đồng hồ lại,
+        // tránh việc khi giải mã đuổi kịp thì mọi frame đều trễ và bị bỏ
+        if (!m_clock->isAudioMaster()) m_clockStalled = true;
+        m_playbackTimer->start(kUnderrunRetryMs);
+        return;
+    }
+    if (m_clockStalled) {
+        m_clockStalled = false;
+        m_clock->start(ptsToUs(frame.pts));
+    }
+
+    const qint64 clockUs = m_clock->now();
+    const qint64 waitUs = ptsToUs(frame.pts) - clockUs;
+    if (waitUs > kEarlyToleranceUs) {
+        m_playbackTimer->start(static_cast<int>((waitUs + 999) / 1000));
+        return;
+    }
+
+    m_frameQueue.tryPop(frame);
+    // Frame kế tiếp cũng đã tới hạn: frame hiện tại đã trễ, bỏ qua
+    FrameData next;
+    while (m_frameQueue.tryPeek(next) && ptsToUs(next.pts) <= clockUs) {
+        m_frameQueue.tryPop(frame);
+        m_droppedFrames++;
+    }
+
+    m_avOffsetUs = ptsToUs(frame.pts) - clockUs;
+    presentStreamFrame(frame);
+    reportPlaybackStats();
+
+    // Lên lịch theo pts của frame kế tiếp
+    if (m_frameQueue.tryPeek(next)) {
+        const qint64 nextWaitUs = ptsToUs(next.pts) - m_clock->now();
+        m_playbackTimer->start(static_cast<int>(qMax<qint64>(0, (nextWaitUs + 999) / 1000)));
     } else {
-        m_isPlaying = false;
-        m_playbackTimer->stop();
+        m_playbackTimer->start(kUnderrunRetryMs);
+    }
+}
+
+void VideoWorker::presentNextReverseFrame()
+{
+    // Phát ngược không có âm thanh: frame tới hạn theo khoảng cách pts tới mốc (đúng cả với VFR)
+    FrameData frame;
+    if (!m_reverseQueue.tryPeek(frame)) {
+        if (m_decodeAheadEof) {
+            finishPlayback();
+            return;
+        }
+        // Luồng giải mã chưa kịp: thử lại sớm thay vì chặn luồng worker, rồi tính nhịp lại từ frame đang hiển thị
+        m_reverseStalled = true;
+        m_playbackTimer->start(kUnderrunRetryMs);
+        return;
     }
+    if (m_reverseStalled) {
+        m_reverseStalled = false;
+        m_reverseAnchorUs = ptsToUs(m_currentPts);
+        m_reverseClock.start();
+    }
+
+    const qint64 waitUs = m_reverseAnchorUs - ptsToUs(frame.pts) - m_reverseClock.nsecsElapsed() / 1000;
+    if (waitUs > kEarlyToleranceUs) {
+        m_playbackTimer->start(static_cast<int>((waitUs + 999) / 1000));
+        return;
+    }
+    m_reverseQueue.tryPop(frame);
+    presentFrame(frame);
+    if (!m_isPlaying) return;
+
+    FrameData next;
+    if (m_reverseQueue.tryPeek(next)) {
+        const qint64 nextWaitUs = m_reverseAnchorUs - ptsToUs(next.pts) - m_reverseClock.nsecsElapsed() / 1000;
+        m_playbackTimer->start(static_cast<int>(qMax<qint64>(0, (nextWaitUs + 999) / 1000)));
+    } else {
+        m_playbackTimer->start(kUnderrunRetryMs);
+    }
+}
+
+void VideoWorker::finishPlayback()
+{
+    m_isPlaying = false;
+    m_playbackTimer->stop();
+    m_clock->pause();
+    stopDecodeAhead();
+    m_playReverse = false;
+    reportPlaybackStats();
+    applyOutputSize();
+    if (m_currentFrameScaled) refreshCurrentFrame();
+}
+
+void VideoWorker::reportPlaybackStats()
+{
+    if (m_statsTimer.elapsed() < 1000 && m_isPlaying) return;
+    m_statsTimer.restart();
+    emit playbackStatsChanged(m_avOffsetUs, m_droppedFrames);
 }
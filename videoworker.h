@@ -1,11 +1,22 @@
-// videoworker.h - Version 1.3 (Thêm cờ isSeeking)
+// videoworker.h - Version 3.4 (Bỏ âm thanh khi không có thiết bị phát)
 #ifndef VIDEOWORKER_H
 #define VIDEOWORKER_H
 
 #include <QObject>
 #include <QTimer>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <QMutex>
+#include <QThreadPool>
 #include <memory> 
 #include "videoprocessor.h"
+#include "framequeue.h"
+#include "framecache.h"
+#include "playbackclock.h"
+#include "audiodecoder.h"
+#include "encodepipeline.h"
+
+class QThread;
 
 class VideoWorker : public QObject
 {
@@ -15,29 +26,177 @@ public:
     explicit VideoWorker(QObject *parent = nullptr);
     ~VideoWorker();
 
+    // Gọi trực tiếp từ luồng GUI khi kéo thanh thời gian. Chỉ mốc mới nhất được thực hiện;
+    // lần tua đang chạy bị hủy khi có mốc mới hơn.
+    void postSeek(qint64 timestamp);
+    // Đồng hồ chủ dùng chung: bên phát âm thanh cập nhật vị trí âm thanh vào đây
+    std::shared_ptr<PlaybackClock> playbackClock() const;
+    // PCM đã giải mã chờ phát; AudioOutput đọc từ đây
+    std::shared_ptr<AudioRingBuffer> audioRing() const;
+    // Hủy lần chụp loạt đang chạy; gọi được từ luồng bất kỳ
+    void cancelBurstCapture();
+    // Hàng đợi mã hóa dùng chung với MainWindow; đặt trước khi chuyển worker sang luồng của nó
+    void setEncodePipeline(std::shared_ptr<EncodePipeline> pipeline);
+
 public slots:
     void processOpenFile(const QString &filePath);
     void processSeek(qint64 timestamp);
+    void processSeekToFrame(int frameNumber);
     void processPlayPause(bool play);
+    void processPlayReverse(bool play);
     void processNextFrame();
     void processPrevFrame();
+    void setDecoderThreading(VideoProcessor::DecoderThreading mode, int threadCount);
+    void setDecodeAheadLimits(int maxFrames, qint64 maxBytes);
+    void setFrameCacheLimit(qint64 maxBytes);
+    void setDisplaySize(const QSize &size);
+    void setScrubbing(bool scrubbing);
+    // Tắt tiếng: packet âm thanh bị bỏ ở demuxer; bật lại khi đang phát thì đồng bộ lại tại vị trí hiện tại
+    void setAudioMuted(bool muted);
+    // AudioOutput báo có/không có sink đang đọc PCM; không có thì xử lý như tắt tiếng
+    void setAudioOutputAvailable(bool available);
+    // Giải mã lại frame đang hiển thị ở độ phân giải gốc (VideoProcessor riêng, chạy trên
+    // m_capturePool) để ảnh chụp không phụ thuộc đường hiển thị. Kết quả qua captureReady.
+    void processCapture(bool exportImage);
+    void setCaptureQuality(VideoProcessor::ConversionQuality quality);
+    // Chụp loạt: giải mã tuần tự [startUs, endUs] bằng VideoProcessor chụp, lấy mỗi stride frame một lần
+    // và ghi vào outputDir qua EncodePipeline. Hàng đợi mã hóa đầy thì luồng giải mã chờ
+    // nên bộ nhớ không tăng theo độ dài khoảng.
+    void processBurstCapture(qint64 startUs, qint64 endUs, int stride, const QString &outputDir);
     void stop();
 
 signals:
     void fileOpened(bool success, VideoProcessor::AudioParams params, double frameRate, qint64 duration, AVRational timeBase);
     void frameReady(const FrameData &frameData);
+    // Phát ra tối đa mỗi giây một lần khi đang phát
+    void playbackStatsChanged(qint64 avOffsetUs, quint64 droppedFrames);
+    // Âm thanh chỉ chạy khi đang phát xuôi (nối tới AudioOutput::setActive)
+    void audioActiveChanged(bool active);
+    // Tổng số frame chính xác, phát ra khi chỉ mục frame đã sẵn sàng
+    void frameCountChanged(int frameCount);
+    // Frame ở độ phân giải gốc tại vị trí hiện tại, dùng cho chụp ảnh (phát từ luồng của m_capturePool)
+    void captureReady(const QImage &image, bool exportImage);
+    // total là ước lượng (theo chỉ mục frame nếu có, nếu không thì theo fps)
+    void burstProgress(int saved, int total);
+    // image là ảnh vừa ghi ra filePath, để thư viện không phải giải mã lại file
+    void burstFrameSaved(const QString &filePath, const QImage &image);
+    void burstFinished(int saved, double framesPerSecond);
     void finished();
 
 private slots:
     void onPlaybackTimerTimeout();
+    void onFrameIndexReady();
+    void processPendingSeek();
 
 private:
+    FrameData decodeMeasured();
+    void startDecodeAhead();
+    void stopDecodeAhead();
+    void decodeAheadLoop();
+    void reverseDecodeLoop(int64_t endPts);
+    void presentFrame(const FrameData &frame);
+    void presentNextReverseFrame();
+    void finishPlayback();
+    void reportPlaybackStats();
+    qint64 ptsToUs(int64_t pts) const;
+    void presentStreamFrame(const FrameData &frame);
+    void presentSeekResult(const FrameData &frame);
+    void resyncStream();
+    FrameData decodePreviousFrame();
+    void applyOutputSize();
+    void refreshCurrentFrame();
+    // Âm thanh được giải mã khi không tắt tiếng và có sink đọc PCM
+    bool audioEnabled() const;
+    void updateAudioEnabled(bool wasEnabled);
+    void startIndexing(const QString &filePath);
+    void cancelIndexing();
+
+    // Khai báo trước m_processor: VideoProcessor đóng decoder âm thanh khi bị hủy
+    std::shared_ptr<AudioRingBuffer> m_audioRing;
+    std::unique_ptr<AudioDecoder> m_audioDecoder;
     std::unique_ptr<VideoProcessor> m_processor;
     QTimer *m_playbackTimer;
+    // Lên lịch trình chiếu theo pts so với đồng hồ chủ; frame trễ bị bỏ
+    std::shared_ptr<PlaybackClock> m_clock;
+    bool m_clockStalled = false;
+    bool m_audioMuted = false;
+    bool m_audioOutputAvailable = false;
+    // false khi decoder đã đi qua đoạn mà packet âm thanh bị bỏ (bước frame, phát khi tắt tiếng):
+    // lần phát kế tiếp phải tua lại để âm thanh bắt đầu đúng frame đang hiển thị
+    bool m_audioInSync = true;
+    // Độ lệch (pts video - đồng hồ) của frame trình chiếu gần nhất và số frame đã bỏ vì trễ,
+    // báo qua playbackStatsChanged
+    qint64 m_avOffsetUs = 0;
+    quint64 m_droppedFrames = 0;
+    QElapsedTimer m_statsTimer;
     bool m_isPlaying = false;
+    bool m_playReverse = false;
+    // Phát ngược: frame có pts p tới hạn khi m_reverseClock đạt m_reverseAnchorUs - p (µs).
+    // Đặt lại mốc ở frame đang hiển thị khi bắt đầu và sau mỗi lần luồng giải mã không kịp.
+    QElapsedTimer m_reverseClock;
+    qint64 m_reverseAnchorUs = 0;
+    bool m_reverseStalled = false;
     qint64 m_currentPts = 0;
     // THÊM MỚI: Cờ để ngăn xung đột khi đang tua video
     std::atomic<bool> m_isSeeking = false;
+    // Đo tốc độ giải mã thực tế (frame/giây, không tính thời gian chờ timer)
+    QElapsedTimer m_decodeTimer;
+    qint64 m_decodeNsAccum = 0;
+    int m_decodeFrameCount = 0;
+    VideoProcessor::AllocationStats m_lastAllocStats;
+    // Giải mã trước: luồng riêng đẩy frame vào m_frameQueue, timer chỉ lấy ra
+    FrameQueue m_frameQueue;
+    std::unique_ptr<QThread> m_decodeThread;
+    std::atomic<bool> m_decodeAheadRunning = false;
+    std::atomic<bool> m_decodeAheadEof = false;
+    FrameData m_carryFrame;
+    // Phát ngược: luồng giải mã đẩy từng GOP (đã đảo thứ tự) vào đây
+    FrameQueue m_reverseQueue;
+    // Frame đã giải mã gần đây (khi phát, bước tới và khi giải mã lại GOP để lùi)
+    FrameCache m_frameCache;
+    int64_t m_lastDecodedPts = AV_NOPTS_VALUE; // Frame cuối cùng m_processor giải mã tuần tự
+    int64_t m_streamPts = AV_NOPTS_VALUE;      // Frame đứng ngay trước vị trí đọc của hàng đợi/decoder
+    // Chuyển đổi theo kích thước hiển thị khi phát/tua; chụp ảnh luôn dùng độ phân giải gốc
+    QSize m_displaySize;
+    bool m_isScrubbing = false;
+    bool m_currentFrameScaled = false;
+    QString m_filePath;
+    VideoProcessor::DecoderThreading m_threadingMode = VideoProcessor::ThreadingAuto;
+    int m_threadCount = 0;
+    // Chỉ được dùng trong tác vụ của m_capturePool (tối đa 1 luồng nên các lần chụp chạy tuần tự)
+    std::unique_ptr<VideoProcessor> m_captureProcessor;
+    QThreadPool m_capturePool;
+    std::shared_ptr<EncodePipeline> m_encodePipeline;
+    VideoProcessor::ConversionQuality m_captureQuality = VideoProcessor::ConversionHighQuality;
+    std::atomic<bool> m_burstCancel = false;
+    // Chỉ mục frame/keyframe dựng trên thread pool sau khi mở file
+    QFutureWatcher<std::shared_ptr<const FrameIndex>> *m_indexWatcher;
+    std::shared_ptr<std::atomic<bool>> m_indexCancel;
+    QString m_indexPath;
+    // Gộp yêu cầu tua: luồng GUI ghi mốc mới nhất, worker chỉ thực hiện mốc đó
+    QElapsedTimer m_seekClock;
+    std::atomic<qint64> m_pendingSeekTarget = 0;
+    std::atomic<qint64> m_pendingSeekPostedNs = 0;
+    std::atomic<quint64> m_seekGeneration = 0;
+    std::atomic<bool> m_seekScheduled = false;
+    // postSeek chỉ đặt abort_seek khi lần tua của processPendingSeek đang chạy, để không hủy
+    // các lần tua nội bộ (resyncStream, refreshCurrentFrame, processSeekToFrame...)
+    QMutex m_seekAbortMutex;
+    bool m_pendingSeekRunning = false;
+    std::atomic<qint64> m_lastSeekPresentedNs = 0;
+    quint64 m_handledSeekGeneration = 0;
+    // Mốc kéo cuối cùng: khi thả thanh thời gian sẽ tua chính xác tới đây
+    qint64 m_lastScrubTarget = 0;
+    bool m_hasScrubTarget = false;
+    // Thống kê độ trễ từ lúc kéo tới lúc frame được gửi đi, báo cáo khi thả thanh thời gian
+    struct ScrubStats {
+        int displayed = 0;
+        int aborted = 0;
+        qint64 totalLatencyNs = 0;
+        qint64 maxLatencyNs = 0;
+    };
+    ScrubStats m_scrubStats;
+    std::atomic<int> m_scrubRequests = 0;
 };
 
 #endif // VIDEOWORKER_H
@@ -1,21 +1,93 @@
-// viewpanel.cpp - Version 2.5 (Hoàn thiện logic Crop)
+// viewpanel.cpp - Version 3.2 (Log dựng ảnh ghép tắt mặc định)
 // Change-log:
+// - Version 3.2: Log thời gian dựng/đỉnh bộ nhớ của ảnh ghép độ phân giải gốc chuyển sang lcPerf.
+// - Version 3.1:
+//   - processImage co giãn qua TiledCompositor::scaledItem để ảnh xuất theo tile giống hệt ảnh dựng
+//     trong bộ nhớ; item của TiledCompositor mang cờ cắt giữa thay cho vùng nguồn tự tính.
+// - Version 3.0:
+//   - Thêm createTiledCompositor: vị trí ảnh (layoutRects, dùng chung với renderComposite) và vùng cắt
+//     của từng ảnh gốc để TiledCompositor ghi ảnh ghép lớn theo tile mà không dựng cả ảnh trong bộ nhớ.
+//   - Ghi log thời gian và đỉnh RSS khi dựng ảnh ghép gốc trong bộ nhớ, để so với đường xuất theo tile.
+// - Version 2.9:
+//   - Vùng xem chỉ dựng ảnh ghép từ proxy: mỗi ảnh được co giãn một lần từ ảnh gốc xuống tỉ lệ gần với
+//     tỉ lệ xem (lũy thừa của 2), nên chỉnh kiểu khi đang xem ở 10–30% không còn co giãn ảnh 4K.
+//     Proxy chỉ dựng lại khi phóng to quá độ nét hiện có hoặc thu nhỏ nhiều.
+//   - Kích thước ảnh ghép gốc (nhãn kích thước, fitToWindow) được tính từ kích thước ảnh, không cần pixel.
+//   - Ảnh ghép độ phân giải gốc chỉ được dựng khi xuất hoặc mở cửa sổ cắt (startFullRender), trên luồng
+//     nền có báo tiến độ và hủy được; thay cho getCompositedImage đồng bộ.
+// - Version 2.8:
+//   - processImages co giãn các ảnh song song trên QThreadPool chung (QtConcurrent::mapped) và nhận
+//     kết quả qua QFutureWatcher; luồng giao diện vẫn vẽ ảnh ghép cũ trong lúc chờ. Lần xử lý mới
+//     hủy lần đang chạy. fitToWindow gọi trong lúc chờ được thực hiện khi có kết quả.
+// - Version 2.7:
+//   - Ảnh ghép được dựng một lần (m_compositeCache) và chỉ bị hủy khi ảnh, bố cục hay kiểu (viền, bo góc,
+//     khoảng cách, màu nền) thay đổi. paintEvent chỉ vẽ ảnh đã dựng theo tỉ lệ, nên lăn chuột thu phóng
+//     không còn dựng lại ảnh ghép.
+// - Version 2.6:
+//   - Tách xử lý một ảnh (processImage) khỏi processImages; thêm insertImage/removeImageAt/replaceImage
+//     để đổi dấu chọn một ảnh chỉ co giãn lại đúng ảnh đó.
 // - Version 2.5:
 //   - Triển khai logic crop ảnh thủ công khi ở chế độ Lưới & Tùy chỉnh
 //     để đảm bảo ảnh không bị méo.
 // - Version 2.4: Sửa logic co giãn ảnh.
 
 #include "viewpanel.h"
+#include "tiledcompositor.h"
+#include "perflog.h"
+#include <QDebug>
 #include <QPainter>
 #include <QPainterPath>
+#include <QtConcurrent>
 #include <QtMath>
+#include <cmath>
 #include <limits>
 
 ViewPanel::ViewPanel(QWidget *parent) : QWidget(parent)
 {
+    m_processWatcher = new QFutureWatcher<QImage>(this);
+    connect(m_processWatcher, &QFutureWatcher<QImage>::finished, this, &ViewPanel::onProcessingFinished);
+    m_fullRenderWatcher = new QFutureWatcher<QImage>(this);
+    connect(m_fullRenderWatcher, &QFutureWatcher<QImage>::finished, this, &ViewPanel::onFullRenderFinished);
     setBackgroundColor(m_backgroundColor);
 }
 
+ViewPanel::~ViewPanel()
+{
+    // Tác vụ dựng ảnh gốc phát signal trên đối tượng này: phải xong trước khi hủy
+    cancelFullRender();
+    m_fullRenderWatcher->waitForFinished();
+    m_processWatcher->cancel();
+    m_processWatcher->waitForFinished();
+}
+
+bool ViewPanel::hasImages() const
+{
+    return !m_originalImages.isEmpty();
+}
+
+QSize ViewPanel::compositeSize() const
+{
+    return calculateTotalSize(m_fullSizes, layoutParams(), 1.0);
+}
+
+std::shared_ptr<TiledCompositor> ViewPanel::createTiledCompositor() const
+{
+    const ProcessParams params = processParams();
+    const LayoutParams layout = layoutParams();
+    const QList<QRect> rects = layoutRects(m_fullSizes, layout, 1.0);
+
+    QList<TiledCompositor::Item> items;
+    items.reserve(m_originalImages.count());
+    for (int i = 0; i < m_originalImages.count() && i < rects.count(); ++i) {
+        const QImage &image = m_originalImages[i];
+        if (image.isNull()) continue;
+        bool cropToFill = false;
+        processedSize(image.size(), i == 0, params, &cropToFill);
+        items.append({image, rects[i], cropToFill});
+    }
+    return std::make_shared<TiledCompositor>(compositeSize(), items, layout.backgroundColor, layout.cornerRadius);
+}
+
 void ViewPanel::setImages(const QList<QImage> &images)
 {
     m_originalImages = images;
@@ -46,90 +118,223 @@ void ViewPanel::setCustomSize(int width, int height)
 void ViewPanel::setGridColumnCount(int count)
 {
     m_gridColumnCount = count;
+    // Số cột chỉ đổi bố cục, không đổi kích thước từng ảnh
     if (m_layoutType == Grid) {
+        compositeChanged();
+    }
+}
+
+
+void ViewPanel::insertImage(int index, const QImage &image)
+{
+    index = qBound(0, index, static_cast<int>(m_originalImages.count()));
+    m_originalImages.insert(index, image);
+    // Ở chế độ MatchFirst, đổi ảnh đầu thì mọi ảnh khác phải co giãn lại theo nó.
+    // Đang dựng proxy ở nền thì danh sách proxy chưa khớp: làm lại toàn bộ.
+    if ((index == 0 && m_sizingMode == MatchFirst) || m_processPending) {
         processImages();
+        return;
     }
+    const ProcessParams params = processParams();
+    m_fullSizes.insert(index, processedSize(image.size(), index == 0, params));
+    m_proxyImages.insert(index, processImage(image, index == 0, params, m_proxyScale));
+    compositeChanged();
 }
 
+void ViewPanel::removeImageAt(int index)
+{
+    if (index < 0 || index >= m_originalImages.count()) return;
+    m_originalImages.removeAt(index);
+    if ((index == 0 && m_sizingMode == MatchFirst) || m_processPending) {
+        processImages();
+        return;
+    }
+    m_fullSizes.removeAt(index);
+    m_proxyImages.removeAt(index);
+    compositeChanged();
+}
+
+void ViewPanel::replaceImage(int index, const QImage &image)
+{
+    if (index < 0 || index >= m_originalImages.count()) return;
+    m_originalImages[index] = image;
+    if ((index == 0 && m_sizingMode == MatchFirst) || m_processPending) {
+        processImages();
+        return;
+    }
+    const ProcessParams params = processParams();
+    m_fullSizes[index] = processedSize(image.size(), index == 0, params);
+    m_proxyImages[index] = processImage(image, index == 0, params, m_proxyScale);
+    compositeChanged();
+}
 
 void ViewPanel::processImages()
 {
-    m_processedImages.clear();
+    updateFullSizes();
+    compositeChanged();
+    rebuildProxies();
+}
+
+void ViewPanel::updateFullSizes()
+{
+    const ProcessParams params = processParams();
+    m_fullSizes.clear();
+    for (int i = 0; i < m_originalImages.count(); ++i) {
+        m_fullSizes.append(processedSize(m_originalImages[i].size(), i == 0, params));
+    }
+}
+
+void ViewPanel::rebuildProxies()
+{
+    // Kết quả của lần đang chạy đã lỗi thời
+    if (m_processPending) {
+        m_processWatcher->cancel();
+        m_processPending = false;
+    }
+
+    const double scale = previewScaleFor(m_scale);
     if (m_originalImages.isEmpty()) {
-        update();
-        emit compositedImageSizeChanged(QSize(0,0));
+        m_proxyImages.clear();
+        m_proxyScale = scale;
+        previewChanged();
         return;
     }
 
-    switch (m_sizingMode) {
+    QList<int> indices;
+    indices.reserve(m_originalImages.count());
+    for (int i = 0; i < m_originalImages.count(); ++i) indices.append(i);
+    const QList<QImage> originals = m_originalImages;
+    const ProcessParams params = processParams();
+    m_pendingProxyScale = scale;
+    m_processPending = true;
+    m_processWatcher->setFuture(QtConcurrent::mapped(std::move(indices), [originals, params, scale](int i) {
+        return processImage(originals[i], i == 0, params, scale);
+    }));
+}
+
+void ViewPanel::onProcessingFinished()
+{
+    // Lần xử lý đã bị thay bằng lần mới
+    if (!m_processPending || m_processWatcher->isCanceled()) return;
+    m_processPending = false;
+    m_proxyImages = m_processWatcher->future().results();
+    m_proxyScale = m_pendingProxyScale;
+    previewChanged();
+}
+
+ViewPanel::ProcessParams ViewPanel::processParams() const
+{
+    ProcessParams params;
+    params.sizingMode = m_sizingMode;
+    params.layoutType = m_layoutType;
+    params.customWidth = m_customWidth;
+    params.customHeight = m_customHeight;
+    params.firstSize = m_originalImages.isEmpty() ? QSize() : m_originalImages.first().size();
+    return params;
+}
+
+ViewPanel::LayoutParams ViewPanel::layoutParams() const
+{
+    LayoutParams layout;
+    layout.layoutType = m_layoutType;
+    layout.spacing = m_spacing;
+    layout.border = m_border;
+    layout.cornerRadius = m_cornerRadius;
+    layout.gridColumnCount = m_gridColumnCount;
+    layout.backgroundColor = m_backgroundColor;
+    return layout;
+}
+
+double ViewPanel::previewScaleFor(double viewScale) const
+{
+    const double needed = viewScale * devicePixelRatioF();
+    if (needed >= 1.0) return 1.0;
+    return qBound(1.0 / 64, qPow(2.0, qCeil(std::log2(needed))), 1.0);
+}
+
+void ViewPanel::compositeChanged()
+{
+    m_compositeVersion++;
+    m_previewCache = QImage();
+    m_fullCache = QImage();
+    update();
+    emit compositedImageSizeChanged(calculateTotalSize(m_fullSizes, layoutParams(), 1.0));
+}
+
+void ViewPanel::previewChanged()
+{
+    m_previewCache = QImage();
+    update();
+}
+
+QSize ViewPanel::processedSize(const QSize &size, bool isFirst, const ProcessParams &params, bool *cropToFill)
+{
+    if (cropToFill) *cropToFill = false;
+    if (size.isEmpty()) return size;
+
+    switch (params.sizingMode) {
         case Original:
-            m_processedImages = m_originalImages;
-            break;
+            return size;
 
         case MatchFirst: {
-            QImage firstImage = m_originalImages.first();
-            m_processedImages.append(firstImage);
-            for (int i = 1; i < m_originalImages.count(); ++i) {
-                QImage scaledImage;
-                if (m_layoutType == Horizontal) {
-                    scaledImage = m_originalImages[i].scaledToHeight(firstImage.height(), Qt::SmoothTransformation);
-                } else { 
-                    scaledImage = m_originalImages[i].scaledToWidth(firstImage.width(), Qt::SmoothTransformation);
-                }
-                m_processedImages.append(scaledImage);
+            if (isFirst || params.firstSize.isEmpty()) return size;
+            if (params.layoutType == Horizontal) {
+                const int height = params.firstSize.height();
+                return QSize(qMax(1, qRound(size.width() * double(height) / size.height())), height);
             }
-            break;
+            const int width = params.firstSize.width();
+            return QSize(width, qMax(1, qRound(size.height() * double(width) / size.width())));
         }
 
         case Custom: {
-            for (const QImage &img : m_originalImages) {
-                QImage finalImage;
-                if (m_layoutType == Horizontal && m_customHeight > 0) {
-                    finalImage = img.scaledToHeight(m_customHeight, Qt::SmoothTransformation);
-                } else if (m_layoutType == Vertical && m_customWidth > 0) {
-                    finalImage = img.scaledToWidth(m_customWidth, Qt::SmoothTransformation);
-                } else if (m_layoutType == Grid && m_customWidth > 0 && m_customHeight > 0) {
-                    // === GIẢI PHÁP 2: Logic CROP ảnh thủ công ===
-                    // 1. Phóng to ảnh để lấp đầy khung tùy chỉnh
-                    QImage tempScaled = img.scaled(m_customWidth, m_customHeight, Qt::KeepAspectRatioByExpanding, Qt::SmoothTransformation);
-                    
-                    // 2. Tính toán vùng cần cắt (chính giữa)
-                    int x = (tempScaled.width() - m_customWidth) / 2;
-                    int y = (tempScaled.height() - m_customHeight) / 2;
-                    QRect cropRect(x, y, m_customWidth, m_customHeight);
-
-                    // 3. Cắt và lấy ảnh cuối cùng
-                    finalImage = tempScaled.copy(cropRect);
-                } else {
-                    finalImage = img;
-                }
-                m_processedImages.append(finalImage);
+            const int customWidth = params.customWidth;
+            const int customHeight = params.customHeight;
+            if (params.layoutType == Horizontal && customHeight > 0) {
+                return QSize(qMax(1, qRound(size.width() * double(customHeight) / size.height())), customHeight);
+            } else if (params.layoutType == Vertical && customWidth > 0) {
+                return QSize(customWidth, qMax(1, qRound(size.height() * double(customWidth) / size.width())));
+            } else if (params.layoutType == Grid && customWidth > 0 && customHeight > 0) {
+                if (cropToFill) *cropToFill = true;
+                return QSize(customWidth, customHeight);
             }
-            break;
+            return size;
         }
     }
-    update();
-    emit compositedImageSizeChanged(calculateTotalSize());
+    return size;
+}
+
+QImage ViewPanel::processImage(const QImage &img, bool isFirst, const ProcessParams &params, double scale)
+{
+    if (img.isNull()) return img;
+    bool cropToFill = false;
+    const QSize fullSize = processedSize(img.size(), isFirst, params, &cropToFill);
+    const QSize target = (QSizeF(fullSize) * scale).toSize().expandedTo(QSize(1, 1));
+    return TiledCompositor::scaledItem(img, target, cropToFill);
 }
 
 
 void ViewPanel::setSpacing(int spacing)
 {
     m_spacing = spacing;
-    update();
-    emit compositedImageSizeChanged(calculateTotalSize());
+    compositeChanged();
 }
 
 void ViewPanel::setScale(double newScale)
 {
     m_scale = qBound(0.01, newScale, 5.0);
     emit scaleChanged(m_scale);
+    // Phóng to quá độ nét của proxy, hoặc thu nhỏ nhiều (proxy thừa điểm ảnh): dựng lại proxy
+    const double wanted = previewScaleFor(m_scale);
+    const double current = m_processPending ? m_pendingProxyScale : m_proxyScale;
+    if (!m_originalImages.isEmpty() && (wanted > current || wanted < current / 4)) {
+        rebuildProxies();
+    }
     update();
 }
 
 void ViewPanel::fitToWindow()
 {
-    QSize totalSize = calculateTotalSize();
+    QSize totalSize = calculateTotalSize(m_fullSizes, layoutParams(), 1.0);
     if (!totalSize.isValid() || totalSize.isEmpty()) {
         setScale(1.0);
         return;
@@ -149,45 +354,117 @@ void ViewPanel::setOneToOne()
 void ViewPanel::setBorder(int border)
 {
     m_border = qMax(0, border);
-    update();
-    emit compositedImageSizeChanged(calculateTotalSize());
+    compositeChanged();
 }
 
 void ViewPanel::setCornerRadius(int radius)
 {
     m_cornerRadius = qMax(0, radius);
-    update();
+    compositeChanged();
 }
 
 void ViewPanel::setBackgroundColor(const QColor &color)
 {
     m_backgroundColor = color;
     setStyleSheet(QString("background-color: %1;").arg(m_backgroundColor.name()));
-    update();
+    compositeChanged();
+}
+
+void ViewPanel::startFullRender()
+{
+    if (!m_fullCache.isNull()) {
+        emit fullRenderFinished(m_fullCache);
+        return;
+    }
+    cancelFullRender();
+    if (m_originalImages.isEmpty()) {
+        emit fullRenderFinished(QImage());
+        return;
+    }
+
+    auto cancel = std::make_shared<std::atomic<bool>>(false);
+    m_fullRenderCancel = cancel;
+    m_fullRenderTimer.start();
+    m_fullRenderVersion = m_compositeVersion;
+    const QList<QImage> originals = m_originalImages;
+    const ProcessParams params = processParams();
+    const LayoutParams layout = layoutParams();
+    // Mỗi ảnh một bước, bước cuối là ghép
+    const int total = originals.count() + 1;
+    emit fullRenderProgress(0, total);
+
+    m_fullRenderWatcher->setFuture(QtConcurrent::run([this, originals, params, layout, cancel, total]() {
+        QList<int> indices;
+        for (int i = 0; i < originals.count(); ++i) indices.append(i);
+        std::atomic<int> done = 0;
+        const QList<QImage> processed = QtConcurrent::blockingMapped<QList<QImage>>(indices, [&](int i) {
+            if (*cancel) return QImage();
+            QImage result = processImage(originals[i], i == 0, params, 1.0);
+            emit fullRenderProgress(++done, total);
+            return result;
+        });
+        if (*cancel) return QImage();
+        QImage composite = renderComposite(processed, layout, 1.0, cancel.get());
+        if (!composite.isNull()) emit fullRenderProgress(total, total);
+        return composite;
+    }));
 }
 
-QImage ViewPanel::getCompositedImage() const
+void ViewPanel::cancelFullRender()
 {
-    if (m_processedImages.isEmpty()) {
+    if (m_fullRenderCancel) *m_fullRenderCancel = true;
+}
+
+void ViewPanel::onFullRenderFinished()
+{
+    const bool cancelled = !m_fullRenderCancel || *m_fullRenderCancel;
+    QImage image = cancelled ? QImage() : m_fullRenderWatcher->result();
+    // Ảnh/kiểu đã đổi trong lúc dựng thì không giữ lại
+    if (!cancelled && m_fullRenderVersion == m_compositeVersion) {
+        m_fullCache = image;
+    }
+    if (!image.isNull()) {
+        const qint64 peak = TiledCompositor::peakResidentBytes();
+        qCDebug(lcPerf) << "Full composite" << image.size() << "rendered in" << m_fullRenderTimer.elapsed()
+                 << "ms, process peak RSS" << (peak >= 0 ? peak / (1024 * 1024) : -1) << "MB";
+    }
+    m_fullRenderCancel.reset();
+    emit fullRenderFinished(image);
+}
+
+QImage ViewPanel::previewComposite()
+{
+    if (m_previewCache.isNull()) {
+        m_previewCache = renderComposite(m_proxyImages, layoutParams(), m_proxyScale);
+    }
+    return m_previewCache;
+}
+
+QImage ViewPanel::renderComposite(const QList<QImage> &images, const LayoutParams &layout, double scale,
+                                  const std::atomic<bool> *cancel)
+{
+    if (images.isEmpty()) {
         return QImage();
     }
 
-    QSize totalSize = calculateTotalSize();
+    QList<QSize> sizes;
+    sizes.reserve(images.count());
+    for (const QImage &image : images) sizes.append(image.size());
+    QSize totalSize = calculateTotalSize(sizes, layout, scale);
     if (!totalSize.isValid() || totalSize.isEmpty()) return QImage();
+    const QList<QRect> rects = layoutRects(sizes, layout, scale);
+    if (rects.isEmpty()) return QImage();
 
     QImage resultImage(totalSize, QImage::Format_ARGB32_Premultiplied);
-    resultImage.fill(m_backgroundColor);
+    if (resultImage.isNull()) return QImage();
+    resultImage.fill(layout.backgroundColor);
 
     QPainter painter(&resultImage);
     painter.setRenderHint(QPainter::Antialiasing);
     painter.setRenderHint(QPainter::SmoothPixmapTransform);
 
-    int currentX = m_border;
-    int currentY = m_border;
-    int maxRowHeight = 0;
-
     auto drawRoundedImage = [&](const QImage& img, int x, int y) {
-        int radius = m_cornerRadius > 0 ? (qMin(img.width(), img.height()) * m_cornerRadius / 100) : 0;
+        int radius = layout.cornerRadius > 0 ? (qMin(img.width(), img.height()) * layout.cornerRadius / 100) : 0;
         if (radius > 0) {
             QPainterPath path;
             path.addRoundedRect(QRect(x, y, img.width(), img.height()), radius, radius);
@@ -199,36 +476,52 @@ QImage ViewPanel::getCompositedImage() const
         }
     };
 
-    if (m_layoutType == Horizontal) {
-        for (const QImage &image : m_processedImages) {
-            drawRoundedImage(image, currentX, currentY);
-            currentX += image.width() + m_spacing;
+    for (int i = 0; i < images.count(); ++i) {
+        if (cancel && *cancel) return QImage();
+        drawRoundedImage(images[i], rects[i].x(), rects[i].y());
+    }
+
+    return resultImage;
+}
+
+QList<QRect> ViewPanel::layoutRects(const QList<QSize> &sizes, const LayoutParams &layout, double scale)
+{
+    QList<QRect> rects;
+    const int spacing = qRound(layout.spacing * scale);
+    const int border = qRound(layout.border * scale);
+    int currentX = border;
+    int currentY = border;
+    int maxRowHeight = 0;
+
+    if (layout.layoutType == Horizontal) {
+        for (const QSize &size : sizes) {
+            rects.append(QRect(QPoint(currentX, currentY), size));
+            currentX += size.width() + spacing;
         }
-    } else if (m_layoutType == Vertical) {
-        for (const QImage &image : m_processedImages) {
-            drawRoundedImage(image, currentX, currentY);
-            currentY += image.height() + m_spacing;
+    } else if (layout.layoutType == Vertical) {
+        for (const QSize &size : sizes) {
+            rects.append(QRect(QPoint(currentX, currentY), size));
+            currentY += size.height() + spacing;
         }
     } else { // Grid
-        int cols = (m_gridColumnCount > 0) ? m_gridColumnCount : findBestColumnCount();
-        if (cols == 0) return QImage();
+        int cols = (layout.gridColumnCount > 0) ? layout.gridColumnCount : findBestColumnCount(sizes);
+        if (cols == 0) return rects;
         int current_col = 0;
 
-        for (const QImage &image : m_processedImages) {
-            drawRoundedImage(image, currentX, currentY);
-            currentX += image.width() + m_spacing;
-            maxRowHeight = qMax(maxRowHeight, image.height());
+        for (const QSize &size : sizes) {
+            rects.append(QRect(QPoint(currentX, currentY), size));
+            currentX += size.width() + spacing;
+            maxRowHeight = qMax(maxRowHeight, size.height());
             current_col++;
             if (current_col >= cols) {
                 current_col = 0;
-                currentX = m_border;
-                currentY += maxRowHeight + m_spacing;
+                currentX = border;
+                currentY += maxRowHeight + spacing;
                 maxRowHeight = 0;
             }
         }
     }
-
-    return resultImage;
+    return rects;
 }
 
 void ViewPanel::paintEvent(QPaintEvent *event)
@@ -238,18 +531,19 @@ void ViewPanel::paintEvent(QPaintEvent *event)
     painter.setRenderHint(QPainter::Antialiasing);
     painter.setRenderHint(QPainter::SmoothPixmapTransform);
 
-    if (m_processedImages.isEmpty()) {
+    if (m_originalImages.isEmpty()) {
         return;
     }
 
-    QImage compositedImage = getCompositedImage();
-    if (compositedImage.isNull()) return;
+    // Ảnh ghép từ proxy (tỉ lệ m_proxyScale so với ảnh gốc): vẽ giãn theo tỉ lệ xem
+    const QImage preview = previewComposite();
+    if (preview.isNull()) return;
 
-    QSize scaledSize = compositedImage.size() * m_scale;
+    QSize scaledSize = (QSizeF(preview.size()) * (m_scale / m_proxyScale)).toSize();
     int x = (this->width() - scaledSize.width()) / 2;
     int y = (this->height() - scaledSize.height()) / 2;
 
-    painter.drawImage(QRect(x, y, scaledSize.width(), scaledSize.height()), compositedImage);
+    painter.drawImage(QRect(x, y, scaledSize.width(), scaledSize.height()), preview);
 }
 
 void ViewPanel::wheelEvent(QWheelEvent *event)
@@ -264,16 +558,16 @@ void ViewPanel::wheelEvent(QWheelEvent *event)
     setScale(newScale);
 }
 
-int ViewPanel::findBestColumnCount() const
+int ViewPanel::findBestColumnCount(const QList<QSize> &sizes)
 {
-    if (m_processedImages.isEmpty()) return 0;
-    if (m_processedImages[0].height() == 0) return 1;
-    double imageAspectRatio = (double)m_processedImages[0].width() / m_processedImages[0].height();
+    if (sizes.isEmpty()) return 0;
+    if (sizes[0].height() == 0) return 1;
+    double imageAspectRatio = (double)sizes[0].width() / sizes[0].height();
 
     const double targetAspectRatio = 16.0 / 9.0;
     double bestDiff = std::numeric_limits<double>::max();
     int bestCols = 1;
-    int imageCount = m_processedImages.count();
+    int imageCount = sizes.count();
 
     for (int cols = 1; cols <= imageCount; ++cols) {
         int rows = qCeil((double)imageCount / cols);
@@ -288,47 +582,49 @@ int ViewPanel::findBestColumnCount() const
     return bestCols;
 }
 
-QSize ViewPanel::calculateTotalSize() const
+QSize ViewPanel::calculateTotalSize(const QList<QSize> &sizes, const LayoutParams &layout, double scale)
 {
-    if (m_processedImages.isEmpty()) {
+    if (sizes.isEmpty()) {
         return {0, 0};
     }
 
+    const int spacing = qRound(layout.spacing * scale);
+    const int border = qRound(layout.border * scale);
     int totalWidth = 0;
     int totalHeight = 0;
-    int imageCount = m_processedImages.count();
+    int imageCount = sizes.count();
 
-    if (m_layoutType == Horizontal) {
-        totalWidth = (imageCount > 1) ? (imageCount - 1) * m_spacing : 0;
+    if (layout.layoutType == Horizontal) {
+        totalWidth = (imageCount > 1) ? (imageCount - 1) * spacing : 0;
         int maxHeight = 0;
-        for (const QImage &img : m_processedImages) {
-            totalWidth += img.width();
-            maxHeight = qMax(maxHeight, img.height());
+        for (const QSize &size : sizes) {
+            totalWidth += size.width();
+            maxHeight = qMax(maxHeight, size.height());
         }
         totalHeight = maxHeight;
-    } else if (m_layoutType == Vertical) {
-        totalHeight = (imageCount > 1) ? (imageCount - 1) * m_spacing : 0;
+    } else if (layout.layoutType == Vertical) {
+        totalHeight = (imageCount > 1) ? (imageCount - 1) * spacing : 0;
         int maxWidth = 0;
-        for (const QImage &img : m_processedImages) {
-            totalHeight += img.height();
-            maxWidth = qMax(maxWidth, img.width());
+        for (const QSize &size : sizes) {
+            totalHeight += size.height();
+            maxWidth = qMax(maxWidth, size.width());
         }
         totalWidth = maxWidth;
     } else { // Grid
-        int cols = (m_gridColumnCount > 0) ? m_gridColumnCount : findBestColumnCount();
+        int cols = (layout.gridColumnCount > 0) ? layout.gridColumnCount : findBestColumnCount(sizes);
         if (cols == 0) return {0,0};
         int rows = qCeil((double)imageCount / cols);
         if (rows == 0) return {0,0};
-        
+
         int current_col = 0;
         int max_row_width = 0;
         int current_row_width = 0;
         int current_row_height = 0;
 
-        for(const QImage& img : m_processedImages) {
-            current_row_width += img.width();
-            max_row_width = qMax(max_row_width, current_row_width + (current_col * m_spacing));
-            current_row_height = qMax(current_row_height, img.height());
+        for(const QSize& size : sizes) {
+            current_row_width += size.width();
+            max_row_width = qMax(max_row_width, current_row_width + (current_col * spacing));
+            current_row_height = qMax(current_row_height, size.height());
             current_col++;
             if(current_col >= cols) {
                 totalHeight += current_row_height;
@@ -342,11 +638,11 @@ QSize ViewPanel::calculateTotalSize() const
         }
 
         totalWidth = max_row_width;
-        totalHeight += (rows > 1 ? (rows - 1) * m_spacing : 0);
+        totalHeight += (rows > 1 ? (rows - 1) * spacing : 0);
     }
-    
-    totalWidth += 2 * m_border;
-    totalHeight += 2 * m_border;
+
+    totalWidth += 2 * border;
+    totalHeight += 2 * border;
 
     return {totalWidth, totalHeight};
 }
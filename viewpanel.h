@@ -1,4 +1,4 @@
-// viewpanel.h - Version 2.3 (Grid Columns & Size Signal)
+// viewpanel.h - Version 2.8 (Xuất ảnh ghép lớn theo tile)
 #ifndef VIEWPANEL_H
 #define VIEWPANEL_H
 
@@ -8,6 +8,12 @@
 #include <QSize>
 #include <QWheelEvent>
 #include <QColor>
+#include <QFutureWatcher>
+#include <QElapsedTimer>
+#include <atomic>
+#include <memory>
+
+class TiledCompositor;
 
 class ViewPanel : public QWidget
 {
@@ -18,16 +24,28 @@ public:
     enum SizingMode { Original, MatchFirst, Custom };
 
     explicit ViewPanel(QWidget *parent = nullptr);
+    ~ViewPanel();
 
-    QImage getCompositedImage() const;
+    bool hasImages() const;
+    // Kích thước ảnh ghép ở độ phân giải gốc
+    QSize compositeSize() const;
+    // Ảnh chụp trạng thái hiện tại để dựng ảnh ghép theo tile trên luồng khác
+    std::shared_ptr<TiledCompositor> createTiledCompositor() const;
 
 signals:
     void scaleChanged(double newScale);
     // THÊM MỚI: Signal để gửi kích thước ảnh ghép
     void compositedImageSizeChanged(const QSize &size);
+    // Tiến độ và kết quả của startFullRender (phát trên luồng giao diện); ảnh rỗng nếu bị hủy
+    void fullRenderProgress(int done, int total);
+    void fullRenderFinished(const QImage &image);
 
 public slots:
     void setImages(const QList<QImage> &images);
+    // Cập nhật từng ảnh: chỉ ảnh bị thay đổi được xử lý lại, các ảnh đã xử lý khác được giữ nguyên
+    void insertImage(int index, const QImage &image);
+    void removeImageAt(int index);
+    void replaceImage(int index, const QImage &image);
     void setLayoutType(LayoutType type);
     void setSpacing(int spacing);
     void setScale(double newScale);
@@ -40,19 +58,74 @@ public slots:
     void setCustomSize(int width, int height);
     // THÊM MỚI: Slot để đặt số cột cho chế độ Lưới
     void setGridColumnCount(int count);
-
+    // Dựng ảnh ghép ở độ phân giải gốc trên luồng nền (khi xuất / mở cửa sổ cắt).
+    // Kết quả được giữ lại đến khi ảnh hoặc kiểu trình bày thay đổi.
+    void startFullRender();
+    void cancelFullRender();
 
 protected:
     void paintEvent(QPaintEvent *event) override;
     void wheelEvent(QWheelEvent *event) override;
 
 private:
-    void processImages(); 
-    QSize calculateTotalSize() const;
-    int findBestColumnCount() const;
+    // Các tham số co giãn, chép ra để xử lý trên luồng khác
+    struct ProcessParams {
+        SizingMode sizingMode;
+        LayoutType layoutType;
+        int customWidth;
+        int customHeight;
+        QSize firstSize;
+    };
+    // Các tham số bố cục, chép ra để dựng ảnh ghép trên luồng khác
+    struct LayoutParams {
+        LayoutType layoutType;
+        int spacing;
+        int border;
+        int cornerRadius;
+        int gridColumnCount;
+        QColor backgroundColor;
+    };
+
+    // Ảnh hoặc tham số co giãn đổi: tính lại kích thước gốc rồi dựng lại proxy
+    void processImages();
+    // Dựng lại proxy song song (QtConcurrent) ở tỉ lệ hợp với tỉ lệ xem; kết quả về qua onProcessingFinished
+    void rebuildProxies();
+    ProcessParams processParams() const;
+    LayoutParams layoutParams() const;
+    // Kích thước ảnh sau xử lý ở độ phân giải gốc; cropToFill = cắt giữa để lấp đầy khung
+    static QSize processedSize(const QSize &size, bool isFirst, const ProcessParams &params, bool *cropToFill = nullptr);
+    // Ảnh sau xử lý, thu nhỏ thêm theo scale (1.0 = độ phân giải gốc); chỉ co giãn một lần từ ảnh gốc
+    static QImage processImage(const QImage &image, bool isFirst, const ProcessParams &params, double scale);
+    // Khoảng cách và viền được nhân với scale để ảnh ghép từ proxy giữ đúng tỉ lệ
+    static QSize calculateTotalSize(const QList<QSize> &sizes, const LayoutParams &layout, double scale);
+    static int findBestColumnCount(const QList<QSize> &sizes);
+    // Vị trí từng ảnh trong ảnh ghép
+    static QList<QRect> layoutRects(const QList<QSize> &sizes, const LayoutParams &layout, double scale);
+    static QImage renderComposite(const QList<QImage> &images, const LayoutParams &layout, double scale,
+                                  const std::atomic<bool> *cancel = nullptr);
+    // Tỉ lệ proxy cho tỉ lệ xem: lũy thừa của 2 không nhỏ hơn số điểm ảnh thật trên màn hình
+    double previewScaleFor(double viewScale) const;
+    void updateFullSizes();
+    void onProcessingFinished();
+    void onFullRenderFinished();
+    void compositeChanged(); // Ảnh hoặc kiểu đổi: hủy cả ảnh xem trước và ảnh gốc đã dựng
+    void previewChanged();   // Chỉ proxy đổi (vd. sau khi thu phóng)
+    QImage previewComposite();
 
     QList<QImage> m_originalImages;
-    QList<QImage> m_processedImages;
+    QList<QSize> m_fullSizes;       // Kích thước sau xử lý ở độ phân giải gốc
+    QList<QImage> m_proxyImages;    // Ảnh sau xử lý ở tỉ lệ m_proxyScale
+    double m_proxyScale = 1.0;
+    double m_pendingProxyScale = 1.0;
+    QImage m_previewCache;          // Rỗng = cần dựng lại từ proxy
+    QImage m_fullCache;             // Ảnh ghép độ phân giải gốc; rỗng = chưa dựng
+    QFutureWatcher<QImage> *m_processWatcher;
+    QFutureWatcher<QImage> *m_fullRenderWatcher;
+    std::shared_ptr<std::atomic<bool>> m_fullRenderCancel;
+    quint64 m_compositeVersion = 0; // Tăng mỗi lần ảnh/kiểu đổi, để bỏ kết quả dựng đã lỗi thời
+    quint64 m_fullRenderVersion = 0;
+    QElapsedTimer m_fullRenderTimer;
+    bool m_processPending = false;
     LayoutType m_layoutType = Horizontal;
     int m_spacing = 5;
     double m_scale = 1.0;
@@ -65,7 +138,7 @@ private:
     int m_customWidth = 0;
     int m_customHeight = 0;
     // THÊM MỚI: Biến lưu số cột, 0 = tự động
-    int m_gridColumnCount = 0; 
+    int m_gridColumnCount = 0;
 };
 
 #endif // VIEWPANEL_H